@@ -0,0 +1,110 @@
+/**
+ * @file bench.hpp
+ * @brief Input documents and timing for the benchmarks
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <atomic>
+
+#include "xmlParser.hpp"
+
+namespace lsp::bench
+{
+
+/**
+ * @brief A generated arxml file of about size bytes: packages of elements with references to each other, comments and descriptions,
+ * indented like files written by the usual tools
+ *
+ * @param seed makes the shortnames of different files differ, files with the same seed define the same elements
+ */
+inline std::string makeDocument(uint64_t size, uint32_t seed)
+{
+    std::string document = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- generated <FOO> comment -->\n"
+        "<AUTOSAR xmlns=\"http://autosar.org/schema/r4.0\">\n  <AR-PACKAGES>\n";
+    const std::string prefix = "F" + std::to_string(seed) + "_";
+    for (uint32_t package = 0; document.size() < size; package++)
+    {
+        const std::string packageName = prefix + "Pkg" + std::to_string(package);
+        document += "    <AR-PACKAGE>\n      <SHORT-NAME>" + packageName + "</SHORT-NAME>\n      <ELEMENTS>\n";
+        for (uint32_t element = 0; element < 100; element++)
+        {
+            document += "        <ELEM-" + std::to_string(element % 7) + " UUID=\"" + std::to_string(package * 100 + element) + "\">\n"
+                "          <SHORT-NAME>E" + std::to_string(element) + "</SHORT-NAME>\n"
+                "          <DESC><L-2 L=\"EN\">Element " + std::to_string(element) + " of package " + packageName + "</L-2></DESC>\n"
+                "          <TYPE-TREF DEST=\"TYPE-" + std::to_string(element % 4) + "\">/" + packageName + "/E" + std::to_string((element * 7 + 3) % 100) + "</TYPE-TREF>\n"
+                "          <TYPE-TREF DEST=\"TYPE-0\">/" + prefix + "Pkg0/E" + std::to_string(element) + "</TYPE-TREF>\n"
+                "        </ELEM-" + std::to_string(element % 7) + ">\n";
+        }
+        document += "      </ELEMENTS>\n    </AR-PACKAGE>\n";
+    }
+    document += "  </AR-PACKAGES>\n</AUTOSAR>\n";
+    return document;
+}
+
+/**
+ * @brief The content of a file given on the command line, or a generated document of size bytes if there is none
+ */
+inline std::string loadDocument(int argc, char **argv, uint64_t size)
+{
+    if (argc < 2)
+    {
+        return makeDocument(size, 0);
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+/**
+ * @brief Scan result of numFiles generated documents of about fileSize bytes each, ready to be added to an lsp::ArxmlStorage
+ */
+inline std::vector<lsp::StagedFile> scanDocuments(uint32_t numFiles, uint64_t fileSize)
+{
+    std::vector<lsp::StagedFile> files;
+    for (uint32_t fileNr = 0; fileNr < numFiles; fileNr++)
+    {
+        const std::string document = makeDocument(fileSize, fileNr);
+        std::atomic<uint32_t> noThreads(0);
+        std::string log;
+        files.push_back(lsp::XmlParser::scanContent("file:///x%3A/workspace/file" + std::to_string(fileNr) + ".arxml",
+            document.data(), document.size(), fileNr, lsp::config::IndexSettings(), noThreads, log));
+    }
+    return files;
+}
+
+/**
+ * @brief Runs function runs times and returns the fastest run in seconds, the others are warm-ups or disturbed by something else
+ */
+inline double bestOf(uint32_t runs, const std::function<void()> &function)
+{
+    double best = 1e300;
+    for (uint32_t run = 0; run < runs; run++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+inline double gigabytesPerSecond(uint64_t bytes, double seconds)
+{
+    return bytes / seconds / 1e9;
+}
+
+}
+
+#endif /* BENCH_H */
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "messageParser.hpp"
+#include "types.hpp"
+#include "bench.hpp"
+
+//What the handlers take from the parameters, so neither path can skip decoding them
+struct Decoded
+{
+    uint64_t positions = 0;
+    uint64_t textBytes = 0;
+};
+
+//How messages were handled before the lsp::MessageParser parsed them itself: jsonrpcpp builds its entities from the parsed document,
+//and every handler copied its parameters out of them with to_json() before decoding
+jsonrpcpp::entity_ptr helper_parseWithJsonrpcpp(const std::string &message, Decoded &decoded)
+{
+    jsonrpcpp::entity_ptr entity = jsonrpcpp::Parser::do_parse(message);
+    if (entity->is_notification())
+    {
+        jsonrpcpp::notification_ptr notification = std::dynamic_pointer_cast<jsonrpcpp::Notification>(entity);
+        const json params = notification->params().to_json();
+        decoded.textBytes += params["contentChanges"].back()["text"].get<std::string>().size();
+        return nullptr;
+    }
+    jsonrpcpp::request_ptr request = std::dynamic_pointer_cast<jsonrpcpp::Request>(entity);
+    if (request->method() == "treeView/getChildren")
+    {
+        //The handler looked at its parameters four times, every look was a copy
+        lsp::types::non_standard::GetChildrenParams p;
+        if (request->params().to_json().contains("uri") && request->params().to_json().contains("path"))
+        {
+            p = request->params().to_json().get<lsp::types::non_standard::GetChildrenParams>();
+        }
+        decoded.textBytes += p.path.size();
+    }
+    else
+    {
+        lsp::types::TextDocumentPositionParams p = request->params().to_json().get<lsp::types::TextDocumentPositionParams>();
+        decoded.positions += p.position.line;
+    }
+    return std::make_shared<jsonrpcpp::Response>(request->id(), json(nullptr));
+}
+
+void helper_registerCallbacks(lsp::MessageParser &parser, Decoded &decoded)
+{
+    //No executor, so the requests are answered by parse() like the old path did
+    parser.register_concurrent_request_callback("textDocument/hover",
+        [&decoded](const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token) -> jsonrpcpp::response_ptr
+        {
+            lsp::types::TextDocumentPositionParams p = params.get<lsp::types::TextDocumentPositionParams>();
+            decoded.positions += p.position.line;
+            return std::make_shared<jsonrpcpp::Response>(id, json(nullptr));
+        });
+    parser.register_concurrent_request_callback("treeView/getChildren",
+        [&decoded](const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token) -> jsonrpcpp::response_ptr
+        {
+            lsp::types::non_standard::GetChildrenParams p;
+            if (params.contains("uri") && params.contains("path"))
+            {
+                p = params.get<lsp::types::non_standard::GetChildrenParams>();
+            }
+            decoded.textBytes += p.path.size();
+            return std::make_shared<jsonrpcpp::Response>(id, json(nullptr));
+        });
+    parser.register_notification_callback("textDocument/didChange",
+        [&decoded](const json &params)
+        {
+            decoded.textBytes += params.at("contentChanges").back().at("text").get<std::string>().size();
+        });
+}
+
+std::string helper_frame(const std::string &method, const json &params, int32_t id)
+{
+    json message = {{"jsonrpc", "2.0"}, {"method", method}, {"params", params}};
+    if (id >= 0)
+    {
+        message["id"] = id;
+    }
+    return message.dump();
+}
+
+//Prints the time per message of both paths for count messages
+bool helper_compare(const std::string &name, const std::string &message, uint32_t count)
+{
+    Decoded oldDecoded;
+    Decoded newDecoded;
+    lsp::MessageParser parser;
+    helper_registerCallbacks(parser, newDecoded);
+
+    const double oldTime = lsp::bench::bestOf(5, [&]()
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            helper_parseWithJsonrpcpp(message, oldDecoded);
+        }
+    });
+    const double newTime = lsp::bench::bestOf(5, [&]()
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            parser.parse(message);
+        }
+    });
+    if (oldDecoded.positions != newDecoded.positions || oldDecoded.textBytes != newDecoded.textBytes)
+    {
+        std::cerr << name << ": the message parser decoded other parameters than jsonrpcpp\n";
+        return false;
+    }
+
+    std::cout << name << " (" << message.size() << " bytes)\n"
+        << "  jsonrpcpp + to_json(): " << oldTime / count * 1e6 << " us/message\n"
+        << "  MessageParser:         " << newTime / count * 1e6 << " us/message\n"
+        << "  Speedup: " << oldTime / newTime << "x\n";
+    return true;
+}
+
+//Usage: messageParseBench, parses typical requests and a didChange of a 4MB document both ways
+int main()
+{
+    const std::string uri = "file:///x%3A/workspace/file0.arxml";
+    const json position = {{"textDocument", {{"uri", uri}}}, {"position", {{"line", 1234}, {"character", 56}}}};
+    const json getChildren = {{"uri", uri}, {"path", "/F0_Pkg0/E1"}, {"unique", true}};
+    const json didChange = {
+        {"textDocument", {{"uri", uri}, {"version", 2}}},
+        {"contentChanges", json::array({{{"text", lsp::bench::makeDocument(4 * 1024 * 1024, 0)}}})}
+    };
+
+    bool ok = helper_compare("textDocument/hover", helper_frame("textDocument/hover", position, 1), 20000);
+    ok &= helper_compare("treeView/getChildren", helper_frame("treeView/getChildren", getChildren, 2), 20000);
+    ok &= helper_compare("textDocument/didChange", helper_frame("textDocument/didChange", didChange, -1), 10);
+    return ok ? 0 : 1;
+}
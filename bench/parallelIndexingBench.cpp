@@ -0,0 +1,112 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <set>
+#include <thread>
+
+#include "boost/filesystem.hpp"
+
+#include "xmlParser.hpp"
+#include "config.hpp"
+#include "bench.hpp"
+
+namespace fs = boost::filesystem;
+
+//The parser resolves URIs of Windows paths ("file:///c%3A/..."), so the workspace is generated in a directory named "x:"
+//inside the working directory and found through a relative path on other systems
+std::string helper_makeWorkspace(const fs::path &directory, uint32_t numFiles, uint64_t fileSize)
+{
+    fs::create_directories(directory / "x:" / "workspace");
+    for (uint32_t fileNr = 0; fileNr < numFiles; fileNr++)
+    {
+        std::ofstream file((directory / "x:" / "workspace" / ("file" + std::to_string(fileNr) + ".arxml")).string(), std::ios::binary);
+        file << lsp::bench::makeDocument(fileSize, fileNr);
+    }
+    fs::current_path(directory);
+    return "file:///x%3A/workspace";
+}
+
+//numFiles small files in "x:/shared", all of them with elements in the same package and references to the same target,
+//so every file that is published adds to the same lists by path
+std::string helper_makeSharedTargetWorkspace(const fs::path &directory, uint32_t numFiles)
+{
+    fs::remove_all(directory / "x:" / "shared");
+    fs::create_directories(directory / "x:" / "shared");
+    for (uint32_t fileNr = 0; fileNr < numFiles; fileNr++)
+    {
+        std::ofstream file((directory / "x:" / "shared" / ("file" + std::to_string(fileNr) + ".arxml")).string(), std::ios::binary);
+        file << "<AUTOSAR>\n<AR-PACKAGES>\n<AR-PACKAGE><SHORT-NAME>Common</SHORT-NAME>\n<ELEMENTS>\n";
+        for (uint32_t element = 0; element < 20; element++)
+        {
+            file << "<ELEM><SHORT-NAME>E" << fileNr << "_" << element << "</SHORT-NAME>\n<TYPE-TREF DEST=\"T\">/Common/T</TYPE-TREF>\n</ELEM>\n";
+        }
+        file << "</ELEMENTS>\n</AR-PACKAGE>\n</AR-PACKAGES>\n</AUTOSAR>\n";
+    }
+    fs::current_path(directory);
+    return "file:///x%3A/shared";
+}
+
+double helper_timeIndexing(const std::string &uri)
+{
+    //The parser reports every file it indexed
+    std::streambuf *output = std::cout.rdbuf(nullptr);
+    const double time = lsp::bench::bestOf(3, [&]()
+    {
+        lsp::XmlParser parser;
+        parser.parseFullFolder(uri);
+    });
+    std::cout.rdbuf(output);
+    return time;
+}
+
+//Usage: parallelIndexingBench [folder uri], without a folder 256 generated files of 512kb are indexed,
+//followed by workspaces of 500 to 4000 files sharing a reference target, where the time per file should stay the same
+int main(int argc, char **argv)
+{
+    lsp::config::IndexSettings settings;
+    settings.useIndexCache = false;
+    settings.watchWorkspaceFolders = false;
+    //Only the files are scanned in parallel, not the chunks of a file
+    settings.chunkedParsingMinFileSize = UINT64_MAX;
+
+    fs::path workspace;
+    std::string uri;
+    if (argc > 1)
+    {
+        uri = argv[1];
+    }
+    else
+    {
+        workspace = fs::temp_directory_path() / fs::unique_path("parallelIndexingBench-%%%%%%%%");
+        uri = helper_makeWorkspace(workspace, 256, 512 * 1024);
+    }
+
+    std::set<uint32_t> threadCounts{1, 2, 4, std::max<uint32_t>(std::thread::hardware_concurrency(), 1)};
+    double serialTime = 0;
+    for (uint32_t numThreads : threadCounts)
+    {
+        settings.indexingThreads = numThreads;
+        lsp::config::setIndexSettings(settings);
+        const double time = helper_timeIndexing(uri);
+        if (numThreads == 1)
+        {
+            serialTime = time;
+        }
+        std::cout << numThreads << " thread(s): " << time * 1000 << "ms, " << serialTime / time << "x\n";
+    }
+    std::cout << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    if (!workspace.empty())
+    {
+        settings.indexingThreads = 0;
+        lsp::config::setIndexSettings(settings);
+        for (uint32_t numFiles : {500, 1000, 2000, 4000})
+        {
+            const double time = helper_timeIndexing(helper_makeSharedTargetWorkspace(workspace, numFiles));
+            std::cout << numFiles << " files sharing a reference target: " << time * 1000 << "ms, " << time / numFiles * 1e6 << "us per file\n";
+        }
+        fs::current_path(fs::temp_directory_path());
+        fs::remove_all(workspace);
+    }
+    return 0;
+}
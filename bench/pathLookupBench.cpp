@@ -0,0 +1,102 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+
+#include "boost/multi_index_container.hpp"
+#include "boost/multi_index/ordered_index.hpp"
+#include "boost/multi_index/composite_key.hpp"
+#include "boost/multi_index/mem_fun.hpp"
+#include "boost/multi_index/member.hpp"
+
+#include "arxmlStorage.hpp"
+#include "bench.hpp"
+
+//The index by full path the storage used before the paths were interned: ordered by a full path that is built again for every comparison
+struct OrderedElement
+{
+    std::string name;
+    std::string path;
+    uint32_t fileIndex;
+    std::string getFullPath() const
+    {
+        return path.length() ? path + "/" + name : name;
+    }
+};
+typedef boost::multi_index_container<
+    OrderedElement,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            boost::multi_index::composite_key<
+                OrderedElement,
+                boost::multi_index::const_mem_fun<OrderedElement, std::string, &OrderedElement::getFullPath>,
+                boost::multi_index::member<OrderedElement, uint32_t, &OrderedElement::fileIndex>
+            >
+        >
+    >
+> orderedIndex_t;
+
+//Usage: pathLookupBench, looks up every element of 128 generated files of 512kb by its full path, in random order
+int main()
+{
+    std::vector<lsp::StagedFile> files = lsp::bench::scanDocuments(128, 512 * 1024);
+
+    orderedIndex_t orderedIndex;
+    std::vector<std::pair<std::string, uint32_t>> lookups;
+    for (uint32_t fileIndex = 0; fileIndex < files.size(); fileIndex++)
+    {
+        for (auto &shortname : files[fileIndex].shortnames)
+        {
+            OrderedElement element{shortname.name, shortname.path, fileIndex};
+            lookups.emplace_back(element.getFullPath(), fileIndex);
+            orderedIndex.insert(std::move(element));
+        }
+    }
+    auto storage = std::make_shared<lsp::ArxmlStorage>();
+    for (auto &file : files)
+    {
+        storage->addFile(std::move(file));
+    }
+    std::shuffle(lookups.begin(), lookups.end(), std::mt19937(42));
+
+    //Summed up and printed, so the lookups can't be optimized away
+    uint64_t found = 0;
+    const double orderedAllTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            auto range = orderedIndex.equal_range(boost::make_tuple(lookup.first));
+            found += std::distance(range.first, range.second);
+        }
+    });
+    const double internedAllTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            found += storage->getShortnamesByFullPath(lookup.first).size();
+        }
+    });
+    const double orderedFileTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            found += orderedIndex.count(boost::make_tuple(lookup.first, lookup.second));
+        }
+    });
+    const double internedFileTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            found += storage->getShortnameByFullPath(lookup.first, lookup.second).fileIndex == lookup.second;
+        }
+    });
+
+    auto perLookup = [&](double time) { return time / lookups.size() * 1e9; };
+    std::cout << lookups.size() << " elements (" << found << " found)\n"
+        << "All elements with a full path:  ordered index " << perLookup(orderedAllTime) << "ns, interned path " << perLookup(internedAllTime) << "ns, "
+        << orderedAllTime / internedAllTime << "x\n"
+        << "Element of a file by full path: ordered index " << perLookup(orderedFileTime) << "ns, interned path " << perLookup(internedFileTime) << "ns, "
+        << orderedFileTime / internedFileTime << "x\n";
+    return 0;
+}
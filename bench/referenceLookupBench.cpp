@@ -0,0 +1,73 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <random>
+#include <algorithm>
+
+#include "arxmlStorage.hpp"
+#include "bench.hpp"
+
+//What the linear search of the storage looked at before the references were kept per file
+struct StoredReference
+{
+    uint32_t charOffset;
+    std::string targetPath;
+    uint32_t fileIndex;
+};
+
+//Usage: referenceLookupBench, finds random references of 128 generated files of 512kb by their position, like hover and definition do
+int main()
+{
+    std::vector<lsp::StagedFile> files = lsp::bench::scanDocuments(128, 512 * 1024);
+
+    std::deque<StoredReference> allReferences;
+    for (uint32_t fileIndex = 0; fileIndex < files.size(); fileIndex++)
+    {
+        for (auto &reference : files[fileIndex].references)
+        {
+            allReferences.push_back({reference.charOffset, reference.targetPath, fileIndex});
+        }
+    }
+    auto storage = std::make_shared<lsp::ArxmlStorage>();
+    for (auto &file : files)
+    {
+        storage->addFile(std::move(file));
+    }
+
+    //Positions in the middle of random references
+    std::mt19937 random(42);
+    std::vector<std::pair<uint32_t, uint32_t>> lookups;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        const StoredReference &reference = allReferences[random() % allReferences.size()];
+        lookups.emplace_back(reference.charOffset + reference.targetPath.size() / 2, reference.fileIndex);
+    }
+
+    //Summed up and printed, so the lookups can't be optimized away
+    uint64_t found = 0;
+    const double linearTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            const uint32_t offset = lookup.first;
+            const uint32_t fileIndex = lookup.second;
+            found += std::find_if(allReferences.begin(), allReferences.end(), [offset, fileIndex](const StoredReference &reference)
+            {
+                return offset >= reference.charOffset && offset <= reference.charOffset + reference.targetPath.length() && reference.fileIndex == fileIndex;
+            }) != allReferences.end();
+        }
+    });
+    const double sortedTime = lsp::bench::bestOf(3, [&]()
+    {
+        for (auto &lookup : lookups)
+        {
+            found += storage->getReferenceByOffset(lookup.first, lookup.second).fileIndex == lookup.second;
+        }
+    });
+
+    std::cout << allReferences.size() << " references, " << lookups.size() << " lookups (" << found << " found)\n"
+        << "Linear search over all files: " << linearTime / lookups.size() * 1e6 << "us per lookup\n"
+        << "Binary search in the file:    " << sortedTime / lookups.size() * 1e6 << "us per lookup, " << linearTime / sortedTime << "x\n";
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+#include "structuralScanner.hpp"
+#include "bench.hpp"
+
+//What the parser searches in every file: the start and end of every tag and all newlines
+struct ScanResult
+{
+    uint64_t tags = 0;
+    std::vector<uint32_t> newlineOffsets;
+};
+
+//The loop the parser used before the structural scanner: memchr for the next tag, then for the newlines up to it
+ScanResult helper_scanWithMemchr(const char *start, const char *end)
+{
+    ScanResult result;
+    const char *current = start;
+    const char *newlineCursor = start;
+    while ((current = static_cast<const char*>(memchr(current, '<', end - current))))
+    {
+        while ((newlineCursor = static_cast<const char*>(memchr(newlineCursor, '\n', current - newlineCursor))))
+        {
+            result.newlineOffsets.push_back(newlineCursor - start);
+            ++newlineCursor;
+        }
+        newlineCursor = current;
+        current = static_cast<const char*>(memchr(current, '>', end - current));
+        if (!current)
+        {
+            break;
+        }
+        result.tags++;
+    }
+    while ((newlineCursor = static_cast<const char*>(memchr(newlineCursor, '\n', end - newlineCursor))))
+    {
+        result.newlineOffsets.push_back(newlineCursor - start);
+        ++newlineCursor;
+    }
+    return result;
+}
+
+ScanResult helper_scanWithScanner(const char *start, const char *end)
+{
+    ScanResult result;
+    lsp::StructuralScanner scanner(start, start, end, end, result.newlineOffsets);
+    const char *current = start;
+    while ((current = scanner.findTagOpen(current, end)))
+    {
+        current = scanner.findTagClose(current);
+        if (!current)
+        {
+            break;
+        }
+        result.tags++;
+    }
+    scanner.finish();
+    return result;
+}
+
+//Usage: structuralScannerBench [file], without a file a generated 256MB document is scanned
+int main(int argc, char **argv)
+{
+    const std::string document = lsp::bench::loadDocument(argc, argv, 256 * 1024 * 1024);
+    const char *const start = document.data();
+    const char *const end = start + document.size();
+
+    ScanResult memchrResult;
+    ScanResult scannerResult;
+    const double memchrTime = lsp::bench::bestOf(5, [&]() { memchrResult = helper_scanWithMemchr(start, end); });
+    const double scannerTime = lsp::bench::bestOf(5, [&]() { scannerResult = helper_scanWithScanner(start, end); });
+    if (memchrResult.tags != scannerResult.tags || memchrResult.newlineOffsets != scannerResult.newlineOffsets)
+    {
+        std::cerr << "The scanner found other characters than the memchr loop\n";
+        return 1;
+    }
+
+    std::cout << document.size() / (1024 * 1024) << "MB, " << scannerResult.tags << " tags, " << scannerResult.newlineOffsets.size() << " newlines\n"
+        << "memchr loop:             " << lsp::bench::gigabytesPerSecond(document.size(), memchrTime) << " GB/s\n"
+        << "StructuralScanner (" << lsp::StructuralScanner::getKernelName() << "): " << lsp::bench::gigabytesPerSecond(document.size(), scannerTime) << " GB/s\n"
+        << "Speedup: " << memchrTime / scannerTime << "x\n";
+    return 0;
+}
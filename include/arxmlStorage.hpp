@@ -4,13 +4,11 @@
 #include <string>
 #include <vector>
 #include <deque>
-#include <functional>
-
-#include "boost/multi_index_container.hpp"
-#include "boost/multi_index/ordered_index.hpp"
-#include "boost/multi_index/mem_fun.hpp"
-#include "boost/multi_index/member.hpp"
-#include "boost/multi_index/composite_key.hpp"
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
 
 #include "types.hpp"
 
@@ -26,10 +24,13 @@ struct ShortnameElement
     std::string path;
     uint32_t charOffset;
     uint32_t fileIndex;
-    mutable std::vector<const ShortnameElement*> children;
-    mutable std::vector<const ReferenceElement*> references;
+    //Id of the full path in the path table of the storage, equal for all elements with the same full path
+    uint32_t pathId;
+    const std::string *fullPath;
+    std::vector<const ShortnameElement*> children;
+    std::vector<const ReferenceElement*> references;
     const ShortnameElement* parent;
-    std::string getFullPath() const;
+    const std::string &getFullPath() const;
 };
 
 struct ReferenceElement
@@ -37,39 +38,46 @@ struct ReferenceElement
     std::string name;
     uint32_t charOffset;
     std::string targetPath;
+    //Id of targetPath in the path table of the storage, the same id as the elements with that full path.
+    //The target itself depends on the other files, so it is looked up in the generation that is read (see ArxmlStorage::getTarget)
+    uint32_t targetPathId;
     const ShortnameElement* owner;
     uint32_t fileIndex;
 };
 
-// Typedef for the multi index map for the shortnames
-struct tag_fullPathIndex {};
-struct tag_offsetIndex {};
-typedef boost::multi_index_container<
-    ShortnameElement,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<
-            boost::multi_index::tag<tag_fullPathIndex>,
-            boost::multi_index::composite_key<
-                ShortnameElement,
-                //This is ordered with fileIndex as the second key, so we can search for elements by full path without specifying an fileIndex
-                //This is especially important for references where we don't necessarily know where the element is
-                boost::multi_index::const_mem_fun<ShortnameElement, std::string, &ShortnameElement::getFullPath>,
-                boost::multi_index::member<ShortnameElement, uint32_t, &ShortnameElement::fileIndex>
-            >
-        >,
-        boost::multi_index::ordered_unique<
-            boost::multi_index::tag<tag_offsetIndex>,
-            boost::multi_index::composite_key<
-                ShortnameElement,
-                //This is ordered with fileIndex as first key as it doesnt make much sense to search of an offset without saying what file
-                //This also allows us to use emplace hint effectively, as we can always append at the end, improving performance
-                boost::multi_index::member<ShortnameElement, uint32_t, &ShortnameElement::fileIndex>,
-                boost::multi_index::member<ShortnameElement, uint32_t, &ShortnameElement::charOffset>
-            >
-        >
-    >
-> shortnameContainer_t;
+// Result of scanning a single file before it is added to a storage.
+// Parents and owners are stored as indices into shortnames instead of pointers, so files can be scanned
+// independently (and in parallel) and only get linked when they are merged with ArxmlStorage::addFile
+struct StagedShortname
+{
+    std::string name;
+    std::string path;
+    uint32_t charOffset;
+    int32_t parent;
+};
 
+struct StagedReference
+{
+    std::string name;
+    std::string targetPath;
+    uint32_t charOffset;
+    int32_t owner;
+};
+
+struct StagedFile
+{
+    std::string uri;
+    std::vector<uint32_t> newlineOffsets;
+    std::vector<StagedShortname> shortnames;
+    std::vector<StagedReference> references;
+    //Hash of the content the file was scanned from (see IndexCache::hashContent), to notice when a file is indexed again with the same content
+    uint64_t contentHash;
+};
+
+// A generation of the index of a set of files. A published generation is never changed: a writer creates the next generation
+// with nextGeneration(), adds or replaces files in it and publishes it in place of the old one, while readers keep using the generation
+// they started with for as long as they hold it. The files and the lists by path a change doesn't touch are shared between generations,
+// so creating one only copies pointers and the parts that actually change.
 class ArxmlStorage
 {
 public:
@@ -78,20 +86,37 @@ public:
     const ShortnameElement &getLastShortnameByOffset(const uint32_t &offset, const uint32_t fileIndex) const;
 
     const ShortnameElement &getShortnameByFullPath(const std::string &fullPath, const uint32_t fileIndex) const;
-    std::vector<const lsp::ShortnameElement*> getShortnamesByFullPath(const std::string &fullPath) const;
-
-    std::vector<const ReferenceElement*> getReferencesByShortname(const ShortnameElement &elem) const;
+    //Empty if there is no element with that full path
+    const std::vector<const lsp::ShortnameElement*> &getShortnamesByFullPath(const std::string &fullPath) const;
+
+    const std::vector<const ReferenceElement*> &getReferencesByShortname(const ShortnameElement &elem) const;
+    uint32_t getReferenceCount(const ShortnameElement &elem) const;
+    //Number of elements with the target path of the reference in this generation
+    uint32_t getTargetCount(const ReferenceElement &reference) const;
+    //The element with the target path of the reference, nullptr if there is none or more than one
+    const ShortnameElement *getTarget(const ReferenceElement &reference) const;
+    //Counts the references that have no or more than one target
+    void countUnresolvedReferences(uint32_t &unresolvedReferences, uint32_t &ambiguousReferences) const;
+    //Throws lsp::elementNotFoundException if the path is neither the full path of an element nor the target of a reference in this storage
+    uint32_t getPathId(const std::string_view fullPath) const;
+    //Like getPathId, but a path that is not interned is no error, for lookups that expect to miss
+    std::optional<uint32_t> findPathId(const std::string_view fullPath) const;
     std::vector<const lsp::ShortnameElement*> getShortnamesByPathOnly(const std::string &path) const;
 
-    const lsp::ShortnameElement* addShortname(const ShortnameElement &elem);
-    const lsp::ReferenceElement* addReference(const ReferenceElement &elem);
-    void addFileIndex(std::string uri);
-    uint32_t getFileIndex(std::string uri);
-    std::string getUriFromFileIndex(uint32_t fileIndex);
-    bool containsFile(std::string uri);;
-
-    void addNewlineOffset(const uint32_t newlineOffset, const uint32_t fileIndex);
-    void reserveNewlineOffsets(const uint32_t numNewlineOffsets, const uint32_t fileIndex);
+    //Creates the next generation, which can be changed until it is published. Everything is shared with this one until then
+    std::shared_ptr<ArxmlStorage> nextGeneration() const;
+    //Links the staged elements of a scanned file and takes ownership of its data, returns the new fileIndex
+    uint32_t addFile(StagedFile &&file);
+    //Removes everything of the file at fileIndex and adds the new scan result in its place, the fileIndex and uri stay the same
+    void replaceFile(const uint32_t fileIndex, StagedFile &&file);
+    uint32_t getFileIndex(const std::string &uri) const;
+    std::string getUriFromFileIndex(uint32_t fileIndex) const;
+    bool containsFile(const std::string &uri) const;
+    uint32_t getFileCount() const;
+    uint64_t getContentHash(const uint32_t fileIndex) const;
+    //Key for comparing URIs: percent-encoding decoded, backslashes as slashes and the scheme and drive letter in lower case, as clients differ in all of these,
+    //e.g. "file:///c%3A/Folder/a.arxml" and "file:///C:/Folder/a.arxml" are the same file. The rest of the path is only case insensitive on Windows
+    static std::string normalizeUri(const std::string_view uri);
 
     uint32_t getOffsetFromPosition(const lsp::types::Position &position, const uint32_t fileIndex) const;
     const lsp::types::Position getPositionFromOffset(const uint32_t offset, const uint32_t fileIndex) const;
@@ -99,16 +124,88 @@ public:
     ArxmlStorage();
 
 private:
-    shortnameContainer_t shortnames_;
-    shortnameContainer_t::index<tag_fullPathIndex>::type &shortnamesFullPathIndex_;
-    shortnameContainer_t::index<tag_offsetIndex>::type &shortnamesOffsetIndex_;
-    std::deque<ReferenceElement> references_;
-    std::vector<std::vector<uint32_t>> newlineOffsets_;
-    //sanitizedFilePath_[fileIndex] = corresponding file path
-    std::vector<std::string> URIs_;
+    //Only used by nextGeneration, a copy shares everything with the original
+    ArxmlStorage(const ArxmlStorage&) = default;
+    ArxmlStorage &operator=(const ArxmlStorage&) = delete;
+
+    struct PathTable;
+
+    //Everything of one file. It is never changed once it is built, so all generations containing the file share it
+    struct IndexedFile
+    {
+        //Releases the paths of the file, the last generation containing it is gone
+        ~IndexedFile();
+
+        std::string uri;
+        uint64_t contentHash;
+        std::vector<uint32_t> newlineOffsets;
+        //Both sorted by charOffset. Elements and references point to each other, so the vectors never grow after they are filled
+        std::vector<ShortnameElement> shortnames;
+        std::vector<ReferenceElement> references;
+        //Every path id the file uses: full paths, the paths of its elements and the target paths of its references
+        std::vector<uint32_t> pathIds;
+        std::shared_ptr<PathTable> pathTable;
+    };
+
+    //Everything looked up by a path id. The lists are in the order of the files
+    struct PathEntry
+    {
+        //Generation that created this copy, only that generation may change it
+        uint64_t generation;
+        //Elements with this full path
+        std::vector<const ShortnameElement*> elements;
+        //Elements whose path is this path. The elements without a path are in the entry of ""
+        std::vector<const ShortnameElement*> children;
+        //References with this target path
+        std::vector<const ReferenceElement*> references;
+    };
+    //The entries are copied on write in chunks of consecutive path ids, and the entries inside a copied chunk again only when they change.
+    //Paths are interned in the order they are found, so most paths of a file are in a few chunks
+    struct PathChunk
+    {
+        uint64_t generation;
+        std::vector<std::shared_ptr<PathEntry>> entries;
+    };
+
+    //Interned full paths, shared by all generations. A path is released when no file of any living generation uses it anymore,
+    //its id is then reused for the next new path. A generation only has elements in the lists of the paths its files use,
+    //so the lists of a released id are empty in every generation that is still around.
+    //The keys of pathIds point into paths, a deque never moves its elements.
+    //The lock is needed because a writer interns new paths while readers of older generations look paths up
+    struct PathTable
+    {
+        std::shared_mutex mutex;
+        std::deque<std::string> paths;
+        //Number of living files using each path
+        std::vector<uint32_t> users;
+        std::vector<uint32_t> releasedIds;
+        std::unordered_map<std::string_view, uint32_t> pathIds;
+    };
+
+    //Normalized URI -> fileIndex, only copied when a generation adds a file
+    struct FileTable
+    {
+        uint64_t generation;
+        std::unordered_map<std::string, uint32_t> fileIndices;
+    };
+
+    const IndexedFile &getFile(const uint32_t fileIndex) const;
+    const PathEntry &getPathEntry(const uint32_t pathId) const;
+    //Copies the entry and its chunk first if they belong to an older generation
+    PathEntry &editPathEntry(const uint32_t pathId);
+    //The lock of the path table has to be held exclusively
+    uint32_t internPath(const std::string_view path);
+    void insertFileElements(const uint32_t fileIndex, std::string uri, StagedFile &&file);
+    void removeFileElements(const uint32_t fileIndex);
+
+    uint64_t generation_;
+    std::vector<std::shared_ptr<const IndexedFile>> files_;
+    std::shared_ptr<FileTable> fileTable_;
+    std::vector<std::shared_ptr<PathChunk>> pathChunks_;
+    std::shared_ptr<PathTable> pathTable_;
 };
 
 
 } /* namespace lsp */
 
-#endif /* SHORTNAMESTORAGE_H */
\ No newline at end of file
+#endif /* SHORTNAMESTORAGE_H */
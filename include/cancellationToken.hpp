@@ -0,0 +1,60 @@
+/**
+ * @file cancellationToken.hpp
+ * @brief Flag that tells a running request that the client doesn't need its result anymore
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <atomic>
+#include <memory>
+
+#include "lspExceptions.hpp"
+
+namespace lsp
+{
+
+/**
+ * @brief Shared flag set by a $/cancelRequest notification and checked by the request it belongs to
+ *
+ * Cancellation is cooperative: long loops call throwIfCancelled() every now and then, which throws lsp::requestCancelledException.
+ * Copies share the flag. A default constructed token belongs to no request and is never cancelled
+ */
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+
+    static CancellationToken create()
+    {
+        CancellationToken token;
+        token.cancelled_ = std::make_shared<std::atomic<bool>>(false);
+        return token;
+    }
+
+    void cancel() const
+    {
+        if (cancelled_)
+            *cancelled_ = true;
+    }
+
+    bool isCancelled() const
+    {
+        return cancelled_ && cancelled_->load(std::memory_order_relaxed);
+    }
+
+    void throwIfCancelled() const
+    {
+        if (isCancelled())
+            throw lsp::requestCancelledException();
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+}
+
+#endif /* CANCELLATIONTOKEN_H */
@@ -10,13 +10,34 @@
 #define CONFIG_H
 
 #include <cstdint>
+#include <string>
 
 namespace lsp
 {
     namespace config
     {
-        extern bool shutdown;
-        extern bool referenceLinkToParentShortname;
+        //Settings of the index. The settings that only change the answers, like referenceLinkToParentShortname, belong to each lsp::LanguageService,
+        //as one index can be shared by several clients
+        struct IndexSettings
+        {
+            //Number of threads used for indexing the workspace folder. 0 uses one thread per hardware thread, 1 indexes serially
+            uint32_t indexingThreads = 0;
+            //Files at least this big are split into chunks that are scanned on all indexing threads
+            uint64_t chunkedParsingMinFileSize = 64 * 1024 * 1024;
+            //Scan results of unchanged files are loaded from the index cache instead of parsing the files again
+            bool useIndexCache = true;
+            //Directory of the index cache, empty uses a directory in the temp directory of the system
+            std::string indexCacheDirectory;
+            //Workspace folders are watched for files changed outside of the editor, which are then indexed again
+            bool watchWorkspaceFolders = true;
+            //Milliseconds without new changes in a watched folder before the changed files are indexed
+            uint32_t fileWatcherDebounceTime = 200;
+        };
+
+        //Copy of the current settings. The configuration of the client changes them on the main loop while files are indexed on other threads,
+        //so every indexing job takes a copy when it starts and uses it until it is done
+        IndexSettings getIndexSettings();
+        void setIndexSettings(const IndexSettings &settings);
     }
 }
 
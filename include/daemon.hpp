@@ -0,0 +1,94 @@
+/**
+ * @file daemon.hpp
+ * @brief Server mode that accepts several clients and shares the indexes between them
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+//Before the boost headers, json.hpp doesn't compile after their using directive
+#include "indexRegistry.hpp"
+
+#include "boost/asio.hpp"
+
+#include "transport.hpp"
+
+using namespace boost;
+
+namespace lsp
+{
+
+/**
+ * @brief Listens on a port or a Unix socket and serves every client that connects with a lsp::LanguageService of its own
+ *
+ * Each client is served on a thread of its own, with its own configuration, pending requests and request executor.
+ * Clients with the same workspace share one index through the lsp::IndexRegistry, so editor windows opened on the same model
+ * parse it and hold it in memory once. The settings of the indexes are the defaults in lsp::config, the clients can't change them
+ */
+class Daemon
+{
+public:
+    /**
+     * @brief Construct a new Daemon object listening on a TCP port of the loopback interface
+     *
+     * @param port Port to listen on
+     */
+    Daemon(uint32_t port);
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * @brief Construct a new Daemon object listening on a Unix domain socket
+     *
+     * @param socketPath Path of the socket, a file that is left there by a daemon that didn't exit cleanly is replaced
+     */
+    Daemon(const std::string &socketPath);
+#endif
+    /**
+     * @brief Stops listening and waits for the connected clients to exit
+     *
+     */
+    ~Daemon();
+
+    Daemon(const Daemon&) = delete;
+    Daemon &operator=(const Daemon&) = delete;
+
+    /**
+     * @brief Accept clients until listening fails
+     *
+     */
+    void run();
+
+private:
+    std::unique_ptr<lsp::Transport> accept();
+    //Joins the threads of the clients that are gone
+    void removeFinishedConnections();
+
+    struct Connection
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+    std::list<Connection> connections_;
+    uint32_t nextConnectionID_;
+
+    std::shared_ptr<lsp::IndexRegistry> indexRegistry_;
+    //Outlives the connections, the sockets of the transports belong to it
+    asio::io_context ioc_;
+    std::unique_ptr<asio::ip::tcp::acceptor> tcpAcceptor_;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    std::unique_ptr<asio::local::stream_protocol::acceptor> unixAcceptor_;
+#endif
+    std::string socketPath_;
+};
+
+}
+
+#endif /* DAEMON_H */
@@ -0,0 +1,91 @@
+/**
+ * @file fileWatcher.hpp
+ * @brief Watches a directory for changed, added and removed files on a background thread
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+namespace lsp
+{
+
+/**
+ * @brief Watches the files with an extension in a directory (not its subdirectories) using inotify, and reports them in bursts
+ *
+ * Events are collected until no new event arrived for the debounce time, so a tool writing many files at once
+ * results in one call of the change callback. The callback runs on the thread of the watcher.
+ * On systems without inotify the watcher does nothing and isRunning() is false.
+ */
+class FileWatcher
+{
+public:
+    /**
+     * @brief Called with the names (without directory) of the files that were changed, added or removed during one burst.
+     * If the kernel dropped events, rescan is true and the names are all files currently in the directory.
+     * Returns the number of files that were actually indexed again
+     */
+    typedef std::function<uint32_t(const std::vector<std::string> &fileNames, bool rescan)> changeCallback_t;
+
+    struct Statistics
+    {
+        uint64_t eventsReceived;
+        uint64_t bursts;
+        uint64_t filesReindexed;
+        uint64_t reindexMicroseconds;
+    };
+
+    /**
+     * @brief Construct a new FileWatcher object and start watching
+     *
+     * @param directory directory to watch
+     * @param extension only files ending with this are reported, e.g. ".arxml"
+     * @param onChange called on the watcher thread for every burst of changes
+     * @param debounceTime time without new events after which a burst is reported
+     */
+    FileWatcher(const std::string &directory, const std::string &extension, changeCallback_t onChange, std::chrono::milliseconds debounceTime);
+    /**
+     * @brief Stops watching, waits for a running callback to finish
+     */
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher &operator=(const FileWatcher&) = delete;
+
+    bool isRunning() const { return running_; }
+    const std::string &getDirectory() const { return directory_; }
+    Statistics getStatistics() const;
+
+private:
+    void run();
+    bool hasExtension(const std::string &fileName) const;
+    std::vector<std::string> listDirectory() const;
+
+    std::string directory_;
+    std::string extension_;
+    changeCallback_t onChange_;
+    std::chrono::milliseconds debounceTime_;
+
+    int inotifyFd_;
+    int watchDescriptor_;
+    std::atomic<bool> running_;
+    std::atomic<bool> stop_;
+    std::atomic<uint64_t> eventsReceived_;
+    std::atomic<uint64_t> bursts_;
+    std::atomic<uint64_t> filesReindexed_;
+    std::atomic<uint64_t> reindexMicroseconds_;
+    std::thread thread_;
+};
+
+}
+
+#endif /* FILEWATCHER_H */
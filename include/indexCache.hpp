@@ -0,0 +1,76 @@
+/**
+ * @file indexCache.hpp
+ * @brief Persists the scan results of files on disk, so unchanged files don't have to be parsed again on the next start
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef INDEXCACHE_H
+#define INDEXCACHE_H
+
+#include <string>
+#include <cstdint>
+
+#include "arxmlStorage.hpp"
+
+namespace lsp
+{
+
+/**
+ * @brief Binary cache of scanned files, one cache file per source file in the cache directory
+ *
+ * A cache file is a flat image of a lsp::StagedFile: a header, the newline table, fixed size records for the shortnames and references
+ * and one block with all their strings, each path stored once. Loading it maps the file and copies the records out, nothing is parsed
+ * and no path is built. The records are not used in place, the storage owns the strings of its elements.
+ * An entry is valid if the source file still has the size and modification time it had when it was scanned.
+ * If only the modification time changed, the content hash decides, so touching a file doesn't cause it to be parsed again.
+ * Modification times are coarse, so the hash also decides for a file that was written shortly before it was scanned.
+ * Files whose strings don't fit the 32 bit offsets of the cache file are not cached.
+ */
+class IndexCache
+{
+public:
+    /**
+     * @brief Construct a new IndexCache object for a directory. The directory is created if it doesn't exist,
+     * if that fails the cache is disabled
+     *
+     * @param directory directory for the cache files, an empty string disables the cache
+     */
+    IndexCache(const std::string &directory);
+
+    /**
+     * @brief Load the cached scan result of a file, if there is a valid one
+     *
+     * @param uri uri of the source file
+     * @param filePath path of the source file
+     * @param file receives the cached result, with file.uri set to uri
+     * @return true if the entry was valid and loaded, false if the file has to be parsed
+     */
+    bool load(const std::string &uri, const std::string &filePath, StagedFile &file) const;
+
+    /**
+     * @brief Save the scan result of a file. Errors are ignored, the file just gets parsed again next time
+     *
+     * @param file scan result, file.uri is the uri of the source file and file.contentHash the hash of the content it was scanned from
+     * @param modificationTime modification time of the source file, taken before it was read
+     * @param size size of the source file
+     */
+    void store(const StagedFile &file, int64_t modificationTime, uint64_t size) const;
+
+    bool isEnabled() const { return enabled_; }
+
+    /**
+     * @brief Hash of a file content, used to check if a file with a new modification time still has the same content
+     */
+    static uint64_t hashContent(const char *content, uint64_t size);
+
+private:
+    std::string getCacheFilePath(const std::string &uri) const;
+
+    std::string directory_;
+    bool enabled_;
+};
+
+}
+
+#endif /* INDEXCACHE_H */
@@ -0,0 +1,45 @@
+/**
+ * @file indexRegistry.hpp
+ * @brief Shares the index of a workspace between all clients that have it open
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef INDEXREGISTRY_H
+#define INDEXREGISTRY_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "xmlParser.hpp"
+
+namespace lsp
+{
+
+/**
+ * @brief Reference counted indexes, one per workspace root
+ *
+ * Every lsp::LanguageService gets the index of its workspace from here. Clients with the same workspace get the same lsp::XmlParser,
+ * so it is parsed and held in memory once. The index is destroyed when the last client using it is gone
+ */
+class IndexRegistry
+{
+public:
+    /**
+     * @brief Get the index of a workspace, a new empty one if no client has it open. Can be called from any thread
+     *
+     * @param root identifies the workspace, e.g. its folders
+     */
+    std::shared_ptr<lsp::XmlParser> acquire(const std::string &root);
+
+private:
+    //Only the clients own the indexes, an entry whose index is gone is replaced on the next acquire
+    std::unordered_map<std::string, std::weak_ptr<lsp::XmlParser>> indexes_;
+    std::mutex mutex_;
+};
+
+}
+
+#endif /* INDEXREGISTRY_H */
@@ -10,11 +10,14 @@
 #define IOHANDLER_H
 
 #include <string>
-#include <stack>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
 
-#include "boost/asio.hpp"
-
-using namespace boost;
+#include "transport.hpp"
 
 namespace lsp
 {
@@ -22,34 +25,43 @@ namespace lsp
 /**
  * @brief Manages socket connection, read/write and protocol header generation/stripping 
  * 
+ * The bytes are exchanged through a lsp::Transport, so the messages can go over a socket or over stdin/stdout
  */
 class IOHandler
 {
 public:
     /**
-     * @brief Construct a new IOHandler object and start the connection
+     * @brief Construct a new IOHandler object and start the writer
+     * 
+     * @param transport Connection to the client, already established
+     */
+    IOHandler(std::unique_ptr<lsp::Transport> transport);
+
+    /**
+     * @brief Send the messages that were handed to the writer and stop it
      * 
-     * @param address Address to connect to without port suffix, e.g. "127.0.0.1"
-     * @param port Port to use for the connection
      */
-    IOHandler(const std::string &address, uint32_t port);
+    ~IOHandler();
 
     /**
-     * @brief Add a message to be sent out on the next write, so multiple messages can be sent out on next write
+     * @brief Add a message to be sent out on the next write, so multiple messages can be sent out on next write.
+     * Can be called from any thread
      * 
-     * @param message message to be sent out, without protocol header
+     * @param message message to be sent out, without protocol header. Moved into the queue, pass a temporary to avoid copying it
      */
-    void addMessageToSend(const std::string &message);
+    void addMessageToSend(std::string message);
 
     /**
-     * @brief read one message from the socket. Blocks execution until a message is read
+     * @brief read one message from the transport. Blocks execution until a message is read, without using any CPU while waiting
      * 
      * @return std::string - message without protocol header
+     * @throws lsp::connectionClosedException if the client closed the connection
      */
     std::string readNextMessage();
 
     /**
-     * @brief write all added messages to the socket in reverse order of addition (last added will be sent first)
+     * @brief hand all added messages to the writer thread, which writes them to the transport in order of addition.
+     * Returns without waiting for the write, so a large response doesn't hold up the caller. Can be called from any thread
      * 
      */
     void writeAllMessages();
@@ -58,23 +70,57 @@ private:
     /**
      * @brief blocking read of one message, stripping the protocol header
      * 
+     * Reads whatever the transport has into readBuffer_, so one read can return several messages or only part of one.
+     * Messages that are already complete in the buffer are returned without touching the transport
+     * 
      * @param message result will be written to here
      * @return std::size_t number of bytes read
      */
     std::size_t read_(std::string &message);
 
     /**
-     * @brief blocking write of one message, adding the protocol header
+     * @brief Parse the header at the start of the unread data, if it is complete
      * 
-     * @param message message to be written to socket
+     * @return true if the header is complete, headerLength_ and contentLength_ are set then
+     */
+    bool parseHeader_();
+
+    /**
+     * @brief blocking write of messages in one gather write, adding the protocol headers.
+     * The headers and the bodies are passed to the transport as separate buffers, the bodies are not copied
+     * 
+     * @param messages messages to be written to the transport
      * @return std::size_t number of bytes sent
      */
-    std::size_t write_(const std::string &message);
+    std::size_t write_(const std::deque<std::string> &messages);
+
+    /**
+     * @brief Writer thread, writes everything handed over by writeAllMessages() until it is stopped
+     * 
+     */
+    void runWriter_();
+
+    //Received data, the unread part is [readBegin_, readEnd_). It is moved to the front when the end is reached, and grown if a message doesn't fit
+    std::vector<char> readBuffer_;
+    std::size_t readBegin_;
+    std::size_t readEnd_;
+    //Header of the message at readBegin_, headerLength_ is 0 until the header is complete
+    std::size_t headerLength_;
+    std::size_t contentLength_;
+    //Where to continue looking for the end of the header, so a header that arrives in parts isn't searched from the start every time
+    std::size_t headerSearchOffset_;
 
-    std::stack<std::string> sendStack_;
-    asio::io_context ioc_;
-    asio::ip::tcp::endpoint endpoint_;
-    asio::ip::tcp::socket socket_;
+    //Messages added since the last writeAllMessages()
+    std::deque<std::string> sendQueue_;
+    //Messages handed to the writer thread, which is the only one writing to the transport
+    std::deque<std::string> writeQueue_;
+    bool stopWriter_;
+    //Guards the queues and stopWriter_, messages are added from the main loop, the request executor and the background indexing
+    std::mutex sendMutex_;
+    std::condition_variable messagesToWrite_;
+    std::unique_ptr<lsp::Transport> transport_;
+    //Started last, once the transport is set
+    std::thread writer_;
 };
 
 
@@ -0,0 +1,86 @@
+/**
+ * @file jsonWriter.hpp
+ * @brief Serializes large results straight into the message that is sent, without building a json tree first
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "json.hpp"
+#include "jsonrpcpp.hpp"
+
+#include "types.hpp"
+#include "cancellationToken.hpp"
+
+namespace lsp
+{
+
+/**
+ * @brief Appends JSON text to a string
+ *
+ * Writes the same text nlohmann::json::dump() would for the same values, keys in sorted order and strings escaped the same way.
+ * Only the types that make up large results are supported, everything else is still converted with nlohmann::json
+ */
+class JsonWriter
+{
+public:
+    /**
+     * @brief Construct a new JsonWriter object
+     *
+     * @param out string the JSON text is appended to
+     */
+    JsonWriter(std::string &out);
+
+    void writeString(std::string_view value);
+    void writeUInt(uint64_t value);
+    void writeBool(bool value);
+    void write(const lsp::types::Position &position);
+    void write(const lsp::types::Range &range);
+    void write(const lsp::types::Location &location);
+    void write(const lsp::types::non_standard::ShortnameTreeElement &element);
+
+private:
+    std::string &out_;
+};
+
+/**
+ * @brief A response that is already serialized
+ *
+ * The message is sent as it is, see takeMessage(). to_json() parses it again and is only there for code that handles any response
+ */
+class SerializedResponse : public jsonrpcpp::Response
+{
+public:
+    SerializedResponse(const jsonrpcpp::Id &id, std::string message);
+
+    nlohmann::json to_json() const override;
+
+    /**
+     * @brief Get the message of a response without copying it if it is a SerializedResponse, or serialize it otherwise
+     */
+    static std::string takeMessage(const jsonrpcpp::response_ptr &response);
+
+    /**
+     * @brief Serialize a response with an array of results into the message directly. The message is reserved up front,
+     * and the Content-Length header is only calculated when it is sent, from the finished message.
+     * Checks the token every 1024 elements and throws lsp::requestCancelledException once it is cancelled
+     */
+    static std::shared_ptr<SerializedResponse> fromArray(const jsonrpcpp::Id &id, const std::vector<lsp::types::Location> &results,
+        const CancellationToken &token);
+    static std::shared_ptr<SerializedResponse> fromArray(const jsonrpcpp::Id &id, const std::vector<lsp::types::non_standard::ShortnameTreeElement> &results,
+        const CancellationToken &token);
+
+private:
+    std::string message_;
+};
+
+}
+
+#endif /* JSONWRITER_H */
@@ -11,14 +11,22 @@
 
 #include <string>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 #include "json.hpp"
 #include "jsonrpcpp.hpp"
 
 #include "types.hpp"
 #include "ioHandler.hpp"
+#include "transport.hpp"
 #include "messageParser.hpp"
 #include "xmlParser.hpp"
+#include "requestExecutor.hpp"
+#include "cancellationToken.hpp"
+#include "indexRegistry.hpp"
 
 
 namespace lsp
@@ -27,50 +35,104 @@ namespace lsp
 /**
  * @brief Main run routine, callback definitions for lsp methods
  * 
+ * One LanguageService serves one client. Everything of the connection, like the pending responses and the configuration, belongs to it,
+ * only the index of the workspace is shared with the other clients that have the same workspace open
  */
 class LanguageService
 {
 public:
     /**
-     * @brief start connection, register callbacks and instantiate parsers and IOHandler, then begin main run routine
+     * @brief serve a single client, then begin main run routine. Returns when the client exits or is gone
      * 
-     * @param address Address to connect to without port suffix, e.g. "127.0.0.1"
-     * @param port Port to use for the connectio
+     * @param transport Connection to the client, a lsp::TcpTransport or a lsp::StdioTransport
      */
-    static void start(std::string address, uint32_t port);
-private:
-    static void run();
-    static uint32_t getRequestID();
-    static inline std::shared_ptr<lsp::IOHandler> ioHandler_ = nullptr;
-    static inline std::shared_ptr<lsp::MessageParser> messageParser_ = nullptr;
-    static inline std::shared_ptr<XmlParser> xmlParser_ = nullptr;
+    static void start(std::unique_ptr<lsp::Transport> transport);
 
-    //Callbacks for Language Server Protocol
+    /**
+     * @brief register callbacks and instantiate parsers and IOHandler. The index is acquired once the client initializes
+     * 
+     * @param transport Connection to the client
+     * @param indexRegistry Where the index of the workspace is shared with other clients
+     * @param exclusiveIndex Whether the client is the only one using its index: its configuration changes the settings of the index (lsp::config)
+     * and its open documents are indexed with their unsaved content. If the index is shared with other clients, its settings belong to the lsp::Daemon
+     * and it is only indexed from disk, so no client sees the unsaved edits of another
+     */
+    LanguageService(std::unique_ptr<lsp::Transport> transport, std::shared_ptr<lsp::IndexRegistry> indexRegistry, bool exclusiveIndex);
+    ~LanguageService();
 
-    static jsonrpcpp::response_ptr request_textDocument_hover(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_initialize(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_shutdown(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_textDocument_references(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_textDocument_definition(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_textDocument_owner(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_treeView_getChildren(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_treeView_getParentElement(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    static jsonrpcpp::response_ptr request_treeView_getNearestShortname(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params);
-    
-    static void notification_initialized(const jsonrpcpp::Parameter &params);
-    static void notification_exit(const jsonrpcpp::Parameter &params);
-    static void notification_workspace_didChangeConfiguration(const jsonrpcpp::Parameter &params);
+    LanguageService(const LanguageService&) = delete;
+    LanguageService &operator=(const LanguageService&) = delete;
 
-    static void toClient_request_workspace_configuration();
-    static void toClient_request_workspace_workspaceFolders();
-    static void toClient_request_client_registerCapability(const std::string method);
+    /**
+     * @brief Main run routine, handles messages until the client exits or is gone
+     * 
+     */
+    void run();
+private:
+    uint32_t getRequestID();
+    //The index of the workspace, acquired by request_initialize
+    std::shared_ptr<XmlParser> getIndex();
+
+    std::shared_ptr<lsp::IndexRegistry> indexRegistry_;
+    const bool exclusiveIndex_;
+    bool shutdown_;
+    std::atomic<uint32_t> nextRequestID_;
+    //Read by requests running on the request executor while the main loop applies a new configuration
+    std::atomic<bool> referenceLinkToParentShortname_;
+    std::shared_ptr<lsp::IOHandler> ioHandler_;
+    std::shared_ptr<lsp::MessageParser> messageParser_;
+    //Set once by the main loop while requests might already run on the executor, only accessed with std::atomic_load/std::atomic_store
+    std::shared_ptr<XmlParser> xmlParser_;
+    std::shared_ptr<lsp::RequestExecutor> requestExecutor_;
+
+    //Changes of an open document are indexed on the executor, one after another per document. While one is indexed,
+    //the next change replaces the one that is waiting, so a burst of edits scans the document at most twice
+    struct DocumentUpdate
+    {
+        bool waiting;
+        //Text of the document to index, none to index the file on disk
+        std::optional<std::string> content;
+    };
+    //Documents with an update waiting or being indexed
+    std::unordered_map<lsp::types::DocumentUri, DocumentUpdate> documentUpdates_;
+    std::mutex documentUpdatesMutex_;
+    void updateDocument(const lsp::types::DocumentUri &uri, std::optional<std::string> content);
+    //Runs on the executor until no update of the document is waiting anymore
+    void indexDocumentUpdates(const lsp::types::DocumentUri &uri);
 
-    static void toClient_notification_telemetry_event(const json &params);
-    static void toClient_notification_telemetry_event_error(const lsp::types::arxmlError error);
+    //Callbacks for Language Server Protocol
 
-    static void response_workspace_configuration(const json &results);
-    static void response_workspace_workspaceFolders(const json &results);
-    static void response_void(const json &results);
+    jsonrpcpp::response_ptr request_textDocument_hover(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_initialize(const jsonrpcpp::Id &id, const json &params);
+    jsonrpcpp::response_ptr request_shutdown(const jsonrpcpp::Id &id, const json &params);
+    jsonrpcpp::response_ptr request_textDocument_references(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_textDocument_definition(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_textDocument_owner(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_treeView_getChildren(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_treeView_getParentElement(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_treeView_getNearestShortname(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_workspace_getWatcherStatistics(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    jsonrpcpp::response_ptr request_workspace_getCancellationStatistics(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token);
+    
+    void notification_initialized(const json &params);
+    void notification_exit(const json &params);
+    void notification_workspace_didChangeConfiguration(const json &params);
+    void notification_textDocument_didOpen(const json &params);
+    void notification_textDocument_didChange(const json &params);
+    void notification_textDocument_didSave(const json &params);
+    void notification_textDocument_didClose(const json &params);
+    void notification_cancelRequest(const json &params);
+
+    void toClient_request_workspace_configuration();
+    void toClient_request_workspace_workspaceFolders();
+    void toClient_request_client_registerCapability(const std::string method);
+
+    void toClient_notification_telemetry_event(const json &params);
+    void toClient_notification_telemetry_event_error(const lsp::types::arxmlError error);
+
+    void response_workspace_configuration(const json &results);
+    void response_workspace_workspaceFolders(const json &results);
+    void response_void(const json &results);
 };
 
 
@@ -52,6 +52,22 @@ namespace lsp
             return "bad URI format";
         }
     };
+
+    struct connectionClosedException : public std::exception
+    {
+        const char* what() const throw()
+        {
+            return "Connection was closed";
+        }
+    };
+
+    struct requestCancelledException : public std::exception
+    {
+        const char* what() const throw()
+        {
+            return "Request was cancelled";
+        }
+    };
 }
 
 #endif /* LSPEXCEPTIONS_H */
\ No newline at end of file
@@ -10,10 +10,18 @@
 #define LSPPARSER_H
 
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
 
 #include "json.hpp"
 #include "jsonrpcpp.hpp"
 
+#include "requestExecutor.hpp"
+#include "cancellationToken.hpp"
+#include "types.hpp"
+
 using namespace nlohmann;
 
 namespace lsp
@@ -24,16 +32,25 @@ namespace lsp
  * @brief Manages message parsing and callback assignment/execution
  * 
  */
-class MessageParser: public jsonrpcpp::Parser
+class MessageParser
 {
 typedef std::function<void(const json &results)> response_callback;
+typedef std::function<void(jsonrpcpp::response_ptr response)> response_handler;
+//The parameters are the "params" member of the parsed message, or null if it has none
+typedef std::function<void(const json &params)> notification_callback;
+typedef std::function<jsonrpcpp::response_ptr(const jsonrpcpp::Id &id, const json &params)> request_callback;
+typedef std::function<jsonrpcpp::response_ptr(const jsonrpcpp::Id &id, const json &params, const CancellationToken &token)> cancellable_request_callback;
 
 public:
     /**
      * @brief Parse message and execute assigned callback, if applicable
      * 
+     * The message is parsed once and the method is looked up once, the callbacks read their parameters from the parsed message.
+     * Notifications without a callback are ignored, requests without one are answered with MethodNotFound
+     * 
      * @param json_str message to be parsed
      * @return jsonrpcpp::entity_ptr result of callback or nullptr
+     * @throws lsp::badEntityException if the message is no JSON-RPC message, or a response nobody waits for
      */
     jsonrpcpp::entity_ptr parse(const std::string &json_str);
 
@@ -58,7 +75,7 @@ public:
      * @param notification The method string on which the callback should execute
      * @param callback function to execute with message parameters
      */
-    void register_notification_callback(const std::string &notification, jsonrpcpp::notification_callback callback);
+    void register_notification_callback(const std::string &notification, notification_callback callback);
 
     /**
      * @brief REgister a callback to a request from the client
@@ -66,12 +83,63 @@ public:
      * @param request The method string on which the callback should execute
      * @param callback function to execute with message paramters. Should return the result to the corresponding request
      */
-    void register_request_callback(const std::string &request, jsonrpcpp::request_callback callback);
+    void register_request_callback(const std::string &request, request_callback callback);
+
+    /**
+     * @brief Register a callback to a request from the client that only reads the index, so it can run at the same time as other requests
+     * 
+     * Once an executor is set, these requests are answered on its threads and parse() returns right away.
+     * Their responses are passed to the response handler when they are done, in any order.
+     * All other messages are still handled by parse() one after another.
+     * 
+     * A request cancelled with cancel_request() before it started is not run, one that is running is stopped once its callback
+     * throws lsp::requestCancelledException. Both are answered with a RequestCancelled error
+     * 
+     * @param request The method string on which the callback should execute
+     * @param callback function to execute with message paramters and the cancellation token of the request, called from the threads of the executor.
+     * Should return the result to the corresponding request
+     */
+    void register_concurrent_request_callback(const std::string &request, cancellable_request_callback callback);
+
+    /**
+     * @brief Set the executor for requests registered with register_concurrent_request_callback()
+     * 
+     * @param executor threads the requests are answered on
+     * @param handler called from the threads of the executor with every response
+     */
+    void set_request_executor(std::shared_ptr<RequestExecutor> executor, response_handler handler);
+
+    /**
+     * @brief Cancel a request registered with register_concurrent_request_callback() that is not answered yet, for $/cancelRequest.
+     * Can be called from any thread
+     * 
+     * @param id ID of the request to cancel
+     */
+    void cancel_request(const jsonrpcpp::Id &id);
+
+    /**
+     * @brief How many requests were cancelled and how much of their work was saved
+     */
+    lsp::types::non_standard::CancellationStatistics get_cancellation_statistics();
 
 private:
-    std::map<uint32_t, response_callback> response_callbacks_;
-    std::map<std::string, jsonrpcpp::notification_callback> notification_callbacks_;
-    std::map<std::string, jsonrpcpp::request_callback> request_callbacks_;
+    //Callbacks of a method, only the one matching the kind of the message is called
+    struct MethodCallbacks
+    {
+        notification_callback notification;
+        request_callback request;
+        cancellable_request_callback concurrentRequest;
+    };
+    std::unordered_map<uint32_t, response_callback> response_callbacks_;
+    std::unordered_map<std::string, MethodCallbacks> method_callbacks_;
+    std::shared_ptr<RequestExecutor> executor_;
+    response_handler response_handler_;
+
+    //Cancellation tokens of the submitted requests that are not answered yet, by the JSON of their id
+    std::map<std::string, CancellationToken> pending_requests_;
+    lsp::types::non_standard::CancellationStatistics cancellation_statistics_{};
+    //Guards pending_requests_ and cancellation_statistics_, the requests are finished on the threads of the executor
+    std::mutex pending_requests_mutex_;
 };
 
 
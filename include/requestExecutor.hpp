@@ -0,0 +1,72 @@
+/**
+ * @file requestExecutor.hpp
+ * @brief Thread pool that answers requests concurrently to the main loop
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef REQUESTEXECUTOR_H
+#define REQUESTEXECUTOR_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace lsp
+{
+
+/**
+ * @brief Runs tasks on a fixed number of worker threads, in the order they were submitted
+ *
+ * Tasks start in submission order but finish in any order, so a slow task only occupies one worker and the ones after it
+ * are run on the others. Exceptions thrown by a task are printed and otherwise ignored, a task has to report its own errors.
+ */
+class RequestExecutor
+{
+public:
+    /**
+     * @brief Construct a new RequestExecutor object and start the workers
+     *
+     * @param numThreads number of worker threads, 0 uses one per hardware thread, but at least two
+     */
+    RequestExecutor(uint32_t numThreads);
+    /**
+     * @brief Runs the tasks that are still queued and waits for the workers
+     */
+    ~RequestExecutor();
+
+    RequestExecutor(const RequestExecutor&) = delete;
+    RequestExecutor &operator=(const RequestExecutor&) = delete;
+
+    /**
+     * @brief Queue a task, it is started by the next free worker. Can be called from any thread
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Block until every task submitted so far has finished
+     */
+    void waitUntilIdle();
+
+    uint32_t getThreadCount() const { return workers_.size(); }
+
+private:
+    void run();
+
+    std::deque<std::function<void()>> tasks_;
+    //Tasks that are queued or running
+    uint32_t pendingTasks_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable taskAvailable_;
+    std::condition_variable idle_;
+    std::vector<std::thread> workers_;
+};
+
+}
+
+#endif /* REQUESTEXECUTOR_H */
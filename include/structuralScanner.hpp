@@ -0,0 +1,163 @@
+/**
+ * @file structuralScanner.hpp
+ * @brief Finds the structural characters of an arxml file using bitmasks of 64 byte blocks
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef STRUCTURALSCANNER_H
+#define STRUCTURALSCANNER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace lsp
+{
+
+/**
+ * @brief Positions of the structural characters in a 64 byte block. Bit n is set if byte n of the block is the character
+ *
+ */
+struct StructuralMasks
+{
+    uint64_t tagOpen;   // '<'
+    uint64_t tagClose;  // '>'
+    uint64_t slash;     // '/'
+    uint64_t quote;     // '"'
+    uint64_t newline;   // '\n'
+};
+
+typedef void (*classifyBlock_t)(const char *block, StructuralMasks &masks);
+
+/**
+ * @brief Forward moving cursor over a range of a file, that classifies the file in 64 byte blocks and answers searches from the bitmasks.
+ *
+ * Every block is classified exactly once when the cursor first reaches it, and the newlines of the block are collected right then,
+ * so the newline table is built in the same pass as the tags are searched.
+ * The classification kernel (AVX2, SSE2 or scalar) is chosen once at startup, based on what the CPU supports.
+ */
+class StructuralScanner
+{
+public:
+    /**
+     * @brief Construct a new scanner starting at rangeBegin
+     *
+     * @param start start of the file, offsets are relative to this
+     * @param rangeBegin first position the scanner will look at. Positions passed to the scanner should mostly move forward
+     * @param rangeEnd newlines are only collected up to this position
+     * @param end end of the file, searches can continue up to here
+     * @param newlineOffsets newlines in [rangeBegin, rangeEnd) are appended here
+     */
+    StructuralScanner(const char *start, const char *rangeBegin, const char *rangeEnd, const char *end, std::vector<uint32_t> &newlineOffsets);
+
+    /**
+     * @brief Find the next '<' in [position, limit)
+     *
+     * @return const char* position of the character or nullptr if there is none
+     */
+    const char *findTagOpen(const char *position, const char *limit) { return find(&StructuralMasks::tagOpen, '<', position, limit); }
+
+    /**
+     * @brief Find the next '>' in [position, end of file)
+     *
+     * @return const char* position of the character or nullptr if there is none
+     */
+    const char *findTagClose(const char *position) { return find(&StructuralMasks::tagClose, '>', position, end_); }
+
+    /**
+     * @brief Find the next '"' or '>' in [position, end of file), so the quotes of a tag can be found on the way to its end
+     *
+     * @return const char* position of the character or nullptr if there is none
+     */
+    const char *findQuoteOrTagClose(const char *position) { return find(&StructuralMasks::quote, '"', &StructuralMasks::tagClose, '>', position, end_); }
+
+    /**
+     * @brief Check if the character at position is a '/'
+     */
+    bool isSlash(const char *position)
+    {
+        if (position < block_)
+            return *position == '/';
+        moveTo(position);
+        return (masks_.slash >> (position - block_)) & 1;
+    }
+
+    /**
+     * @brief Classify the rest of the range, so all newlines up to rangeEnd are collected
+     */
+    void finish();
+
+    /**
+     * @brief Name of the classification kernel used on this CPU, e.g. "AVX2"
+     */
+    static const char *getKernelName();
+
+private:
+    const char *find(uint64_t StructuralMasks::*mask, char character, const char *position, const char *limit)
+    {
+        return find(mask, character, mask, character, position, limit);
+    }
+
+    const char *find(uint64_t StructuralMasks::*mask, char character, uint64_t StructuralMasks::*otherMask, char otherCharacter,
+        const char *position, const char *limit)
+    {
+        //Positions behind the current block are only ever a few bytes inside a tag, e.g. the text of a reference after searching its end,
+        //so that part is searched directly
+        for (; position < block_ && position < limit; ++position)
+        {
+            if (*position == character || *position == otherCharacter)
+                return position;
+        }
+        if (position >= limit)
+            return nullptr;
+        moveTo(position);
+        uint64_t bits = ((masks_.*mask) | (masks_.*otherMask)) & (~0ULL << (position - block_));
+        while (!bits)
+        {
+            if (block_ + 64 >= limit)
+                return nullptr;
+            nextBlock();
+            bits = (masks_.*mask) | (masks_.*otherMask);
+        }
+        const char *found = block_ + countTrailingZeros(bits);
+        return found < limit ? found : nullptr;
+    }
+
+    void moveTo(const char *position)
+    {
+        while (position >= block_ + 64)
+            nextBlock();
+    }
+
+    static uint32_t countTrailingZeros(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return index;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+    void nextBlock();
+    void classify();
+
+    const char *const start_;
+    const char *const rangeEnd_;
+    const char *const end_;
+    std::vector<uint32_t> &newlineOffsets_;
+    const char *block_;
+    StructuralMasks masks_;
+    static const classifyBlock_t kernel_;
+};
+
+
+}
+
+#endif /* STRUCTURALSCANNER_H */
@@ -0,0 +1,130 @@
+/**
+ * @file transport.hpp
+ * @brief Byte streams the lsp::IOHandler exchanges messages over: a TCP or Unix socket, or stdin/stdout
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "boost/asio.hpp"
+
+using namespace boost;
+
+namespace lsp
+{
+
+/**
+ * @brief Connection to the client as a plain byte stream. The protocol headers are handled by the lsp::IOHandler
+ *
+ * readSome() is only called by the thread reading messages and write() only by the writer thread, so an implementation
+ * has to allow one read and one write at the same time, but not two of either
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Blocking read of whatever arrived, up to size bytes. Doesn't use any CPU while waiting
+     *
+     * @return std::size_t number of bytes read, at least 1
+     * @throws lsp::connectionClosedException if the client closed the connection
+     */
+    virtual std::size_t readSome(char *data, std::size_t size) = 0;
+
+    /**
+     * @brief Blocking write of all buffers, in order
+     *
+     * @throws boost::system::system_error if the connection is broken
+     */
+    virtual void write(const std::vector<asio::const_buffer> &buffers) = 0;
+};
+
+/**
+ * @brief Transport over a TCP connection, opened by the server to the client or accepted from a client by the lsp::Daemon
+ *
+ */
+class TcpTransport : public Transport
+{
+public:
+    /**
+     * @brief Construct a new TcpTransport object and connect
+     *
+     * @param address Address to connect to without port suffix, e.g. "127.0.0.1"
+     * @param port Port to use for the connection
+     */
+    TcpTransport(const std::string &address, uint32_t port);
+    /**
+     * @brief Construct a new TcpTransport object from an accepted connection
+     *
+     * @param socket connected socket, its io_context has to outlive the transport
+     */
+    TcpTransport(asio::ip::tcp::socket socket);
+
+    std::size_t readSome(char *data, std::size_t size) override;
+    void write(const std::vector<asio::const_buffer> &buffers) override;
+
+private:
+    //Only used by a connection the transport opens itself
+    asio::io_context ioc_;
+    asio::ip::tcp::socket socket_;
+};
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+/**
+ * @brief Transport over a Unix domain socket connection accepted by the lsp::Daemon
+ *
+ */
+class UnixSocketTransport : public Transport
+{
+public:
+    /**
+     * @param socket connected socket, its io_context has to outlive the transport
+     */
+    UnixSocketTransport(asio::local::stream_protocol::socket socket);
+
+    std::size_t readSome(char *data, std::size_t size) override;
+    void write(const std::vector<asio::const_buffer> &buffers) override;
+
+private:
+    asio::local::stream_protocol::socket socket_;
+};
+#endif
+
+/**
+ * @brief Transport over stdin and stdout of the server, for clients that start the server as a child process
+ *
+ * stdout belongs to the protocol while this exists: everything else written to it, like the diagnostics on std::cout,
+ * goes to stderr instead
+ */
+class StdioTransport : public Transport
+{
+public:
+    StdioTransport();
+    /**
+     * @brief Gives stdout back to std::cout
+     *
+     */
+    ~StdioTransport();
+
+    StdioTransport(const StdioTransport&) = delete;
+    StdioTransport &operator=(const StdioTransport&) = delete;
+
+    std::size_t readSome(char *data, std::size_t size) override;
+    void write(const std::vector<asio::const_buffer> &buffers) override;
+
+private:
+    //Descriptors of stdin and of the original stdout, descriptor 1 is stderr while the transport exists
+    int inFd_;
+    int outFd_;
+};
+
+}
+
+#endif /* TRANSPORT_H */
@@ -68,6 +68,18 @@ namespace types
     };
     NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TextDocumentIdentifier, uri)
 
+    struct DidSaveTextDocumentParams
+    {
+        lsp::types::TextDocumentIdentifier textDocument;
+    };
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(DidSaveTextDocumentParams, textDocument)
+
+    struct DidCloseTextDocumentParams
+    {
+        lsp::types::TextDocumentIdentifier textDocument;
+    };
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(DidCloseTextDocumentParams, textDocument)
+
     struct TextDocumentPositionParams
     {
         lsp::types::TextDocumentIdentifier textDocument;
@@ -128,6 +140,32 @@ namespace types
         };
         NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GetChildrenParams, path, uri, unique)
 
+        struct WatcherStatistics
+        {
+            std::string directory;
+            bool running;
+            uint64_t eventsReceived;
+            uint64_t bursts;
+            uint64_t filesReindexed;
+            //Milliseconds spent updating the changed files
+            uint64_t reindexTime;
+        };
+        NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(WatcherStatistics, directory, running, eventsReceived, bursts, filesReindexed, reindexTime)
+
+        struct CancellationStatistics
+        {
+            uint64_t cancelRequests;
+            //Cancelled while still queued, never started
+            uint64_t skipped;
+            //Stopped while running, before the response was built
+            uint64_t stopped;
+            //Milliseconds the stopped requests ran before they noticed
+            uint64_t stoppedRunTime;
+            //The request was already answered, or the id was never seen
+            uint64_t tooLate;
+        };
+        NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(CancellationStatistics, cancelRequests, skipped, stopped, stoppedRunTime, tooLate)
+
         struct OwnerParams
         {
             lsp::types::Position pos;
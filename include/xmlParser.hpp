@@ -4,44 +4,200 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
 
 #include "boost/iostreams/device/mapped_file.hpp"
+#include "boost/filesystem/path.hpp"
 
 #include "types.hpp"
+#include "config.hpp"
 #include "arxmlStorage.hpp"
+#include "fileWatcher.hpp"
+#include "cancellationToken.hpp"
 
 namespace lsp
 {
 
+class IndexCache;
 
 class XmlParser
 {
     struct StorageElement
     {
-        std::shared_ptr<lsp::ArxmlStorage> storage;
-        uint32_t lastUsedID;
+        //Current generation of the storage. Writers publish a new one under the lock, requests keep the one they started with
+        std::shared_ptr<const lsp::ArxmlStorage> storage;
+        //Storage of a file that was requested before the folder it belongs to was known. It is dropped once the folder indexed the file
+        bool singleFile;
     };
 
 public:
+    //Stops the background indexing and waits for it
+    ~XmlParser();
+
     const lsp::types::Hover getHover(const lsp::types::TextDocumentPositionParams &params);
     const lsp::types::LocationLink getDefinition(const lsp::types::TextDocumentPositionParams &params);
-    std::vector<lsp::types::Location> getReferences(const lsp::types::ReferenceParams &params);
-    std::vector<lsp::types::non_standard::ShortnameTreeElement> getChildren(const lsp::types::non_standard::GetChildrenParams &params);
+    //The queries whose results grow with the index check the token while they go through it and throw lsp::requestCancelledException once it is cancelled
+    //linkToParentShortname is a setting of the client, as the index can be shared by several of them
+    std::vector<lsp::types::Location> getReferences(const lsp::types::ReferenceParams &params, bool linkToParentShortname, const CancellationToken &token);
+    std::vector<lsp::types::non_standard::ShortnameTreeElement> getChildren(const lsp::types::non_standard::GetChildrenParams &params, const CancellationToken &token);
     lsp::types::Location getOwner(const lsp::types::non_standard::OwnerParams &params);
     lsp::types::non_standard::ShortnameTreeElement getNearestShortname(const lsp::types::TextDocumentPositionParams &params);
     lsp::types::non_standard::ShortnameTreeElement getParent(const std::string path, const std::string uri);
 
     void preParse(const lsp::types::DocumentUri uri);
+    //Indexes the files of a folder on all indexing threads. The scanned files are published to the storage of the folder in batches while the others
+    //are scanned, so requests from other threads are answered from the files indexed so far
     void parseFullFolder(const lsp::types::DocumentUri uri);
-;
+    //Parses the folders one after another on a background thread and calls onFinished from that thread when all of them are indexed.
+    //Only the first call parses, an index shared by several clients calls the onFinished of later calls when that parse is done, or right away if it is
+    void parseFoldersInBackground(const std::vector<lsp::types::DocumentUri> &uris, std::function<void()> onFinished);
+    //Parses a file that is already indexed again, from disk or from the given content.
+    //Files that are not indexed yet and files whose content didn't change since they were indexed are skipped.
+    //A file given with its content (an opened document) is indexed right away if it is still queued, or indexed first by a folder parsed later
+    void reindexFile(const lsp::types::DocumentUri uri);
+    void reindexFile(const lsp::types::DocumentUri uri, const std::string &content);
+    //Indexes an opened document next, from disk: right away if it is still queued, or first by a folder parsed later.
+    //Returns false if the file is not known yet
+    bool prioritizeFile(const lsp::types::DocumentUri uri);
+    std::vector<lsp::types::non_standard::WatcherStatistics> getWatcherStatistics();
+
+    //Scans a file from its content. A file of at least settings.chunkedParsingMinFileSize is scanned in chunks, with as many of the
+    //idleThreads as it can take besides the calling thread, up to settings.indexingThreads. They are given back when the scan is done
+    static StagedFile scanContent(const std::string uri, const char *const start, const uint64_t size, const uint64_t contentHash,
+        const lsp::config::IndexSettings &settings, std::atomic<uint32_t> &idleThreads, std::string &log);
+
 
 private:
-    std::shared_ptr<lsp::ArxmlStorage> getStorageForUri(const lsp::types::DocumentUri uri);
-    void parseSingleFile(const std::string sanitizedFilePath, std::shared_ptr<ArxmlStorage> storage);
-    void parseNewlines(boost::iostreams::mapped_file &mmap, std::shared_ptr<ArxmlStorage> storage, uint32_t fileIndex);
-    void parseShortnamesAndReferences(boost::iostreams::mapped_file &mmap, std::shared_ptr<ArxmlStorage> storage, uint32_t fileIndex);
+    //Result of scanning one part of a file. Parents and owners are indices into this chunk,
+    //or -1 if they are one of the elements that were open when the chunk started and are only known after stitching
+    struct ScannedChunk
+    {
+        std::vector<uint32_t> newlineOffsets;
+        std::vector<StagedShortname> shortnames;
+        std::vector<StagedReference> references;
+        //Relative depth the elements open before the chunk were popped to, at the time each element was found
+        std::vector<int64_t> shortnameIncomingPopDepths;
+        std::vector<int64_t> referenceIncomingPopDepths;
+        //State at the end of the chunk, used to calculate the open elements at the start of the next one
+        std::vector<std::pair<int64_t, int32_t>> depthElements;
+        int64_t incomingPopDepth;
+        int64_t endDepth;
+        const char* endPosition;
+    };
+
+    //An element that is still open at the start of a chunk, index is the index in the whole file
+    struct OpenElement
+    {
+        int64_t depth;
+        int32_t index;
+        const std::string* name;
+    };
+
+    //Take the lock only to get the current generation of the storage for the file, the request is then answered from it without the lock.
+    //A file that is not known yet is indexed into a storage of its own first
+    std::shared_ptr<const lsp::ArxmlStorage> getSnapshot(const lsp::types::DocumentUri uri);
+    //Throws lsp::elementNotFoundException if the file is still waiting to be indexed in the background, after moving it to the front of the queue
+    std::shared_ptr<const lsp::ArxmlStorage> getSnapshot(const lsp::types::DocumentUri uri, uint32_t &fileIndex);
+    std::shared_ptr<const lsp::ArxmlStorage> getSnapshot(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed);
+    //Current generation of the storage containing the file, nullptr if the file is not known yet. mutex_ has to be held
+    std::shared_ptr<const lsp::ArxmlStorage> getStorageForUri(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed);
+    //Scans a file that is not known yet without holding the locks and adds it in a storage of its own
+    std::shared_ptr<const lsp::ArxmlStorage> indexSingleFile(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed);
+    //Called by the watcher of a folder with the files that changed on disk. Changed files are indexed again,
+    //new ones are added to the storage of the folder. Returns the number of files that were indexed
+    uint32_t updateFolderFiles(std::list<StorageElement>::iterator storageElement, const boost::filesystem::path &directory,
+        const std::vector<std::string> &fileNames, bool rescan);
+    //Returns true if the file was indexed again, because its content changed
+    bool reindexFromDisk(const lsp::types::DocumentUri uri);
+    //True if a storage contains the file with a different content than the one with contentHash. Takes the lock
+    bool isOutdated(const lsp::types::DocumentUri uri, const uint64_t contentHash);
+    //Replaces the file in every storage that contains it and prints the log of its scan. Takes the locks, the new generations are built without mutex_
+    void replaceFile(StagedFile &&file, const std::string &log);
+    //Moves a file that is still queued for the background indexing to the front and remembers it as prioritized. Returns false if it isn't queued
+    bool prioritizeQueuedFile(const lsp::types::DocumentUri uri);
+
+    //Scanning does not touch any shared state, so multiple files can be scanned at the same time
+    //Files that are unchanged since they were last scanned are loaded from the index cache instead
+    static StagedFile scanFile(const std::string uri, const IndexCache &cache, const lsp::config::IndexSettings &settings,
+        std::atomic<uint32_t> &idleThreads, std::string &log);
+    static bool scanChunked(const char *const start, const std::vector<const char*> &boundaries, StagedFile &file, uint32_t numThreads);
+    static void fixupChunk(ScannedChunk &chunk, const std::vector<OpenElement> &openElements, int64_t startDepth, int32_t firstIndex);
+    //Collects newlines, shortnames and references in [rangeBegin, rangeEnd) in a single pass. Offsets are relative to start,
+    //end is the end of the file, as elements starting in the range can continue after it
+    static void scanRange(const char *const start, const char *const rangeBegin, const char *const rangeEnd, const char *const end, ScannedChunk &chunk);
 
     std::list<StorageElement> storages_;
+
+    struct UriEntry
+    {
+        std::list<StorageElement>::iterator storageElement;
+        uint32_t fileIndex;
+    };
+    //Normalized URI (see ArxmlStorage::normalizeUri) of every file in storages_. A file that is in multiple storages maps to the first one
+    std::unordered_map<std::string, UriEntry> uris_;
+    void addUris(std::list<StorageElement>::iterator storageElement);
+
+    //Scan result of a file of an indexing job that is waiting to be published with the next batch
+    struct ScannedFile
+    {
+        uint32_t fileIndex;
+        StagedFile file;
+        std::string log;
+    };
+
+    //A folder whose files are being indexed by parseFullFolder
+    struct IndexingJob
+    {
+        std::list<StorageElement>::iterator storageElement;
+        //File indices no worker has taken yet, the next one is taken from the front
+        std::deque<uint32_t> queue;
+        //File indices whose scan result is not in the storage yet
+        std::unordered_set<uint32_t> unindexed;
+        //Files that were opened or requested. Once they are indexed, the files defining their reference targets are moved up
+        std::unordered_set<uint32_t> prioritized;
+        //Last names of the reference targets of indexed prioritized files, the next free indexing thread looks for the files defining them
+        std::unordered_set<std::string> targetNames;
+        //Scanned files that are not published yet. Every generation copies the lists by path the new files are added to and the table of all files,
+        //so publishing every file on its own takes time quadratic in the number of files sharing a path. They are published in batches instead
+        std::vector<ScannedFile> scanned;
+        //One of the workers is publishing the scanned files, the others go on scanning
+        bool publishing = false;
+    };
+    //Removes a file from the job because its scan result is published now, and switches it from a storage of its own to the folder storage.
+    //targetNames are the last names of the reference targets of the file if it is prioritized, empty otherwise
+    void dequeueFile(IndexingJob &job, const uint32_t fileIndex, const lsp::types::DocumentUri &uri, const std::vector<std::string> &targetNames);
+    //Moves the queued files that define one of the job's target names to the front of the queue
+    void prioritizeTargets(IndexingJob &job, const std::vector<std::string> &uris);
+    //True if the scanned files of the job should be published now: the batch is big enough compared to the files published so far,
+    //contains a prioritized file, or no file is left to scan. mutex_ has to be held
+    bool isBatchReady(const IndexingJob &job);
+    //Publishes the scanned files of the job in one generation, and again as long as the next batch is ready. Called by the worker that set job.publishing
+    void publishScanned(IndexingJob &job, const std::vector<std::string> &uris);
+    std::list<IndexingJob> indexingJobs_;
+    //Normalized URIs of files that were opened or requested before their folder was parsed, they are indexed first once it is
+    std::unordered_set<std::string> priorityUris_;
+    std::list<std::thread> indexingThreads_;
+    std::atomic<bool> stopIndexing_{false};
+    //State of parseFoldersInBackground, the callbacks are waiting for the folders to be indexed
+    bool foldersQueued_ = false;
+    bool foldersIndexed_ = false;
+    std::vector<std::function<void()>> onFoldersIndexed_;
+
+    //Held by everything that publishes a new generation or removes a storage, from taking the current generation until the new one is published,
+    //so writers build their generations one after another without holding mutex_. Always taken before mutex_
+    std::mutex writeMutex_;
+    //Guards the storage elements and everything above. Writers hold it while they build and publish a new generation,
+    //requests only while they look up the generation they answer from
+    std::mutex mutex_;
+    //Declared last, so the watchers are stopped before anything they use is destroyed
+    std::list<std::unique_ptr<FileWatcher>> watchers_;
 };
 
 
@@ -1,44 +1,147 @@
 #include "arxmlStorage.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+#include <unordered_map>
 
 #include "lspExceptions.hpp"
-#include "boost/tuple/tuple.hpp"
+
+//Number of consecutive path ids that are copied together when a generation changes one of them
+static const uint32_t pathChunkSize = 1024;
+
+//Generations of all storages are numbered from one counter, so a copied entry can never look like it belongs to another generation
+uint64_t helper_newGeneration()
+{
+    static std::atomic<uint64_t> lastGeneration{0};
+    return ++lastGeneration;
+}
 
 lsp::ArxmlStorage::ArxmlStorage()
-    : shortnames_(),
-      shortnamesFullPathIndex_{shortnames_.get<tag_fullPathIndex>()},
-      shortnamesOffsetIndex_{shortnames_.get<tag_offsetIndex>()}
-    {}
+    : generation_(helper_newGeneration()),
+      files_(),
+      fileTable_(std::make_shared<FileTable>()),
+      pathChunks_(),
+      pathTable_(std::make_shared<PathTable>())
+{
+    fileTable_->generation = generation_;
+}
+
+std::shared_ptr<lsp::ArxmlStorage> lsp::ArxmlStorage::nextGeneration() const
+{
+    std::shared_ptr<ArxmlStorage> next(new ArxmlStorage(*this));
+    next->generation_ = helper_newGeneration();
+    return next;
+}
+
+const lsp::ArxmlStorage::IndexedFile &lsp::ArxmlStorage::getFile(const uint32_t fileIndex) const
+{
+    if (fileIndex >= files_.size())
+    {
+        throw lsp::elementNotFoundException();
+    }
+    return *files_[fileIndex];
+}
+
+const lsp::ArxmlStorage::PathEntry &lsp::ArxmlStorage::getPathEntry(const uint32_t pathId) const
+{
+    static const PathEntry emptyEntry{};
+    //Paths interned for a later generation are not in the chunks of this one
+    if (pathId / pathChunkSize < pathChunks_.size())
+    {
+        const std::shared_ptr<PathEntry> &entry = pathChunks_[pathId / pathChunkSize]->entries[pathId % pathChunkSize];
+        if (entry)
+        {
+            return *entry;
+        }
+    }
+    return emptyEntry;
+}
+
+lsp::ArxmlStorage::PathEntry &lsp::ArxmlStorage::editPathEntry(const uint32_t pathId)
+{
+    while (pathChunks_.size() <= pathId / pathChunkSize)
+    {
+        auto chunk = std::make_shared<PathChunk>();
+        chunk->generation = generation_;
+        chunk->entries.resize(pathChunkSize);
+        pathChunks_.push_back(std::move(chunk));
+    }
+    std::shared_ptr<PathChunk> &chunk = pathChunks_[pathId / pathChunkSize];
+    if (chunk->generation != generation_)
+    {
+        chunk = std::make_shared<PathChunk>(*chunk);
+        chunk->generation = generation_;
+    }
+    std::shared_ptr<PathEntry> &entry = chunk->entries[pathId % pathChunkSize];
+    if (!entry)
+    {
+        entry = std::make_shared<PathEntry>();
+        entry->generation = generation_;
+    }
+    else if (entry->generation != generation_)
+    {
+        entry = std::make_shared<PathEntry>(*entry);
+        entry->generation = generation_;
+    }
+    return *entry;
+}
 
 const lsp::ShortnameElement &lsp::ArxmlStorage::getShortnameByFullPath(const std::string &fullPath, const uint32_t fileIndex) const
 {
-    auto res = shortnamesFullPathIndex_.find(boost::make_tuple(fullPath, fileIndex));
-    if (res != shortnamesFullPathIndex_.end())
+    //A full path can only exist once per file, and only a few times across files
+    for (auto element : getShortnamesByFullPath(fullPath))
     {
-        return *res;
+        if (element->fileIndex == fileIndex)
+        {
+            return *element;
+        }
     }
-    else  throw lsp::elementNotFoundException();
+    throw lsp::elementNotFoundException();
 }
 
-std::vector<const lsp::ShortnameElement*> lsp::ArxmlStorage::getShortnamesByFullPath(const std::string &fullPath) const
+const std::vector<const lsp::ShortnameElement*> &lsp::ArxmlStorage::getShortnamesByFullPath(const std::string &fullPath) const
 {
-    std::vector<const lsp::ShortnameElement*> results;
-    for( auto itPair = shortnamesFullPathIndex_.equal_range(fullPath);
-        itPair.first != itPair.second; itPair.first++)
+    static const std::vector<const lsp::ShortnameElement*> noElements;
+    std::optional<uint32_t> pathId = findPathId(fullPath);
+    //Already in file order, which callers expect
+    return pathId ? getPathEntry(*pathId).elements : noElements;
+}
+
+uint32_t lsp::ArxmlStorage::getPathId(const std::string_view fullPath) const
+{
+    std::optional<uint32_t> pathId = findPathId(fullPath);
+    if (pathId)
     {
-        results.push_back(&(*itPair.first));
+        return *pathId;
     }
-    return results;
+    throw lsp::elementNotFoundException();
+}
+
+std::optional<uint32_t> lsp::ArxmlStorage::findPathId(const std::string_view fullPath) const
+{
+    std::shared_lock<std::shared_mutex> lock(pathTable_->mutex);
+    auto res = pathTable_->pathIds.find(fullPath);
+    if (res != pathTable_->pathIds.end())
+    {
+        return res->second;
+    }
+    return std::nullopt;
 }
 
 const lsp::ShortnameElement &lsp::ArxmlStorage::getShortnameByOffset(const uint32_t &offset, const uint32_t fileIndex) const
 {
+    const std::vector<ShortnameElement> &shortnames = getFile(fileIndex).shortnames;
     //Get the element with that has a higher offset that we look for
-    auto res = shortnamesOffsetIndex_.upper_bound(boost::make_tuple(fileIndex, offset));
+    auto res = std::upper_bound(shortnames.begin(), shortnames.end(), offset,
+    [](const uint32_t offset, const ShortnameElement &elem)
+    {
+        return offset < elem.charOffset;
+    });
 
     //First element is already higher than we look for -> not found
-    if(res == shortnamesOffsetIndex_.begin())
+    if(res == shortnames.begin())
     {
         throw lsp::elementNotFoundException();
     }
@@ -54,16 +157,21 @@ const lsp::ShortnameElement &lsp::ArxmlStorage::getShortnameByOffset(const uint3
 
 const lsp::ReferenceElement &lsp::ArxmlStorage::getReferenceByOffset(const uint32_t &offset, const uint32_t fileIndex) const
 {
-    auto res = std::find_if(references_.begin(), references_.end(),
-    [offset, fileIndex](const ReferenceElement &elem)
+    const std::vector<ReferenceElement> &references = getFile(fileIndex).references;
+    //Get the first reference that starts after the offset we look for
+    auto res = std::upper_bound(references.begin(), references.end(), offset,
+    [](const uint32_t offset, const ReferenceElement &elem)
     {
-        if (offset >= elem.charOffset && offset <= (elem.charOffset + elem.targetPath.length()) && elem.fileIndex == fileIndex)
-        {
-            return true;
-        }
-        return false;
+        return offset < elem.charOffset;
     });
-    if (res != references_.end())
+    //First reference already starts after the offset -> not found
+    if (res == references.begin())
+    {
+        throw lsp::elementNotFoundException();
+    }
+    //References don't overlap, so only the previous one can contain the offset
+    --res;
+    if (offset <= (*res).charOffset + (*res).targetPath.length())
     {
         return *res;
     }
@@ -72,126 +180,388 @@ const lsp::ReferenceElement &lsp::ArxmlStorage::getReferenceByOffset(const uint3
 
 const lsp::ShortnameElement &lsp::ArxmlStorage::getLastShortnameByOffset(const uint32_t &offset, const uint32_t fileIndex) const
 {
+    const std::vector<ShortnameElement> &shortnames = getFile(fileIndex).shortnames;
     //Get the element with that has a higher offset that we look for
-    auto res = shortnamesOffsetIndex_.upper_bound(boost::make_tuple(fileIndex, offset));
+    auto res = std::upper_bound(shortnames.begin(), shortnames.end(), offset,
+    [](const uint32_t offset, const ShortnameElement &elem)
+    {
+        return offset < elem.charOffset;
+    });
     //First element is already higher than we look for -> not found
-    if(res == shortnamesOffsetIndex_.begin())
+    if(res == shortnames.begin())
     {
         throw lsp::elementNotFoundException();
     }
-    //Now we can look for the first previous element that matches the fileindex
-    while((*(--res)).fileIndex != fileIndex)
-    {
-        if(res == shortnamesOffsetIndex_.begin())
-            throw lsp::elementNotFoundException();
-    }
-    return *res;
+    return *(--res);
+}
+
+
+const std::vector<const lsp::ReferenceElement*> &lsp::ArxmlStorage::getReferencesByShortname(const ShortnameElement &elem) const
+{
+    return getPathEntry(elem.pathId).references;
+}
+
+uint32_t lsp::ArxmlStorage::getReferenceCount(const ShortnameElement &elem) const
+{
+    return getPathEntry(elem.pathId).references.size();
 }
 
+uint32_t lsp::ArxmlStorage::getTargetCount(const ReferenceElement &reference) const
+{
+    return getPathEntry(reference.targetPathId).elements.size();
+}
+
+const lsp::ShortnameElement *lsp::ArxmlStorage::getTarget(const ReferenceElement &reference) const
+{
+    const std::vector<const ShortnameElement*> &targets = getPathEntry(reference.targetPathId).elements;
+    return targets.size() == 1 ? targets.front() : nullptr;
+}
 
-std::vector<const lsp::ReferenceElement*> lsp::ArxmlStorage::getReferencesByShortname(const ShortnameElement &elem) const
+void lsp::ArxmlStorage::countUnresolvedReferences(uint32_t &unresolvedReferences, uint32_t &ambiguousReferences) const
 {
-    std::vector<const lsp::ReferenceElement*> results;
-    for(auto &ref : references_)
+    for (auto &chunk : pathChunks_)
     {
-        if(ref.targetPath == elem.getFullPath())
+        for (auto &entry : chunk->entries)
         {
-            results.push_back(&ref);
+            if (entry && entry->elements.empty())
+            {
+                unresolvedReferences += entry->references.size();
+            }
+            else if (entry && entry->elements.size() > 1)
+            {
+                ambiguousReferences += entry->references.size();
+            }
         }
     }
-    return results;
 }
 
 std::vector<const lsp::ShortnameElement*> lsp::ArxmlStorage::getShortnamesByPathOnly(const std::string &path) const
 {
-    std::vector<const lsp::ShortnameElement*> results;
-    for (auto &elem: shortnames_)
+    std::optional<uint32_t> pathId = findPathId(path);
+    if (!pathId)
     {
-        if(elem.path == path)
-        {
-            results.push_back(&elem);
-        }
+        return std::vector<const lsp::ShortnameElement*>();
     }
+    std::vector<const lsp::ShortnameElement*> results = getPathEntry(*pathId).children;
+    //Sorted by full path and file like the tree has always been shown
+    std::sort(results.begin(), results.end(), [](const ShortnameElement *a, const ShortnameElement *b)
+    {
+        int compared = a->getFullPath().compare(b->getFullPath());
+        return compared ? compared < 0 : a->fileIndex < b->fileIndex;
+    });
     return results;
 }
 
-const lsp::ShortnameElement* lsp::ArxmlStorage::addShortname(const lsp::ShortnameElement &elem)
+//Moves the elements appended after oldSize to their place in file order, the elements before them are already in file order
+template <typename T>
+void helper_restoreFileOrder(std::vector<const T*> &elements, const size_t oldSize)
 {
-    auto it = shortnamesOffsetIndex_.emplace_hint(shortnamesOffsetIndex_.end(), elem);
-    return &(*it);
+    std::inplace_merge(elements.begin(), elements.begin() + oldSize, elements.end(), [](const T *a, const T *b)
+    {
+        return a->fileIndex < b->fileIndex;
+    });
 }
 
-const lsp::ReferenceElement* lsp::ArxmlStorage::addReference(const lsp::ReferenceElement &elem)
+uint32_t lsp::ArxmlStorage::addFile(StagedFile &&file)
 {
-    references_.push_back(elem);
-    return &(references_.back());
+    uint32_t fileIndex = files_.size();
+    if (fileTable_->generation != generation_)
+    {
+        fileTable_ = std::make_shared<FileTable>(*fileTable_);
+        fileTable_->generation = generation_;
+    }
+    fileTable_->fileIndices.emplace(normalizeUri(file.uri), fileIndex);
+    files_.emplace_back();
+    std::string uri = std::move(file.uri);
+    insertFileElements(fileIndex, std::move(uri), std::move(file));
+    return fileIndex;
 }
 
-void lsp::ArxmlStorage::addNewlineOffset(const uint32_t newlineOffset, const uint32_t fileIndex)
+void lsp::ArxmlStorage::replaceFile(const uint32_t fileIndex, StagedFile &&file)
 {
-    newlineOffsets_[fileIndex].push_back(newlineOffset);
+    std::string uri = files_[fileIndex]->uri;
+    removeFileElements(fileIndex);
+    insertFileElements(fileIndex, std::move(uri), std::move(file));
 }
 
-void lsp::ArxmlStorage::reserveNewlineOffsets(const uint32_t numNewlineOffsets, const uint32_t fileIndex)
+void lsp::ArxmlStorage::insertFileElements(const uint32_t fileIndex, std::string uri, StagedFile &&staged)
 {
-    newlineOffsets_.push_back(std::vector<uint32_t>());
-    newlineOffsets_[fileIndex].reserve(numNewlineOffsets);
-}
+    auto file = std::make_shared<IndexedFile>();
+    file->uri = std::move(uri);
+    file->contentHash = staged.contentHash;
+    file->newlineOffsets = std::move(staged.newlineOffsets);
+    file->shortnames.reserve(staged.shortnames.size());
+    file->references.reserve(staged.references.size());
+    //Elements are appended to the lists by path. Only a list that already has elements of a later file has to be merged afterwards
+    std::unordered_map<uint32_t, size_t> oldElementsSizes;
+    std::unordered_map<uint32_t, size_t> oldChildrenSizes;
+    std::unordered_map<uint32_t, size_t> oldReferencesSizes;
+    auto append = [fileIndex](auto &list, std::unordered_map<uint32_t, size_t> &oldSizes, const uint32_t pathId, auto element)
+    {
+        if (!list.empty() && list.back()->fileIndex > fileIndex)
+        {
+            oldSizes.emplace(pathId, list.size());
+        }
+        list.push_back(element);
+    };
 
-uint32_t lsp::ArxmlStorage::getOffsetFromPosition(const lsp::types::Position &position, const uint32_t fileIndex) const
-{
-    return newlineOffsets_[fileIndex][position.line] + position.character;
+    std::unique_lock<std::shared_mutex> lock(pathTable_->mutex);
+    file->pathTable = pathTable_;
+    //Staged indices to the stored elements. Elements with a full path that already exists in this file are not inserted,
+    //their index maps to the existing element instead, the same way the parser has always treated them
+    std::vector<ShortnameElement*> storedShortnames;
+    storedShortnames.reserve(staged.shortnames.size());
+    std::unordered_map<uint32_t, ShortnameElement*> elementsByPathId;
+    elementsByPathId.reserve(staged.shortnames.size());
+    for (auto &stagedShortname : staged.shortnames)
+    {
+        //The full path is built once here, every later lookup goes through its id
+        const uint32_t pathId = internPath(stagedShortname.path.length() ? stagedShortname.path + "/" + stagedShortname.name : stagedShortname.name);
+        ShortnameElement* &elementPtr = elementsByPathId.emplace(pathId, nullptr).first->second;
+
+        if (!elementPtr)
+        {
+            ShortnameElement element;
+            element.name = std::move(stagedShortname.name);
+            element.path = std::move(stagedShortname.path);
+            element.charOffset = stagedShortname.charOffset;
+            element.fileIndex = fileIndex;
+            element.parent = stagedShortname.parent < 0 ? nullptr : storedShortnames[stagedShortname.parent];
+            element.pathId = pathId;
+            element.fullPath = &pathTable_->paths[pathId];
+            file->shortnames.push_back(std::move(element));
+            elementPtr = &file->shortnames.back();
+            append(editPathEntry(pathId).elements, oldElementsSizes, pathId, elementPtr);
+            const uint32_t parentPathId = internPath(elementPtr->path);
+            append(editPathEntry(parentPathId).children, oldChildrenSizes, parentPathId, elementPtr);
+            file->pathIds.push_back(pathId);
+            file->pathIds.push_back(parentPathId);
+        }
+        if (stagedShortname.parent >= 0)
+        {
+            storedShortnames[stagedShortname.parent]->children.push_back(elementPtr);
+        }
+        storedShortnames.push_back(elementPtr);
+    }
+
+    //The scanner finds the references in the order of the file, so they are already sorted by charOffset
+    for (auto &stagedReference : staged.references)
+    {
+        ReferenceElement reference;
+        reference.name = std::move(stagedReference.name);
+        reference.targetPath = std::move(stagedReference.targetPath);
+        reference.targetPathId = internPath(reference.targetPath);
+        reference.charOffset = stagedReference.charOffset;
+        reference.fileIndex = fileIndex;
+        reference.owner = stagedReference.owner < 0 ? nullptr : storedShortnames[stagedReference.owner];
+        file->references.push_back(std::move(reference));
+        const ReferenceElement *referencePtr = &file->references.back();
+        if (stagedReference.owner >= 0)
+        {
+            storedShortnames[stagedReference.owner]->references.push_back(referencePtr);
+        }
+        append(editPathEntry(referencePtr->targetPathId).references, oldReferencesSizes, referencePtr->targetPathId, referencePtr);
+        file->pathIds.push_back(referencePtr->targetPathId);
+    }
+    std::sort(file->pathIds.begin(), file->pathIds.end());
+    file->pathIds.erase(std::unique(file->pathIds.begin(), file->pathIds.end()), file->pathIds.end());
+    file->pathIds.shrink_to_fit();
+    for (auto pathId : file->pathIds)
+    {
+        pathTable_->users[pathId]++;
+    }
+    lock.unlock();
+
+    for (auto &oldSize : oldElementsSizes)
+    {
+        helper_restoreFileOrder(editPathEntry(oldSize.first).elements, oldSize.second);
+    }
+    for (auto &oldSize : oldChildrenSizes)
+    {
+        helper_restoreFileOrder(editPathEntry(oldSize.first).children, oldSize.second);
+    }
+    for (auto &oldSize : oldReferencesSizes)
+    {
+        helper_restoreFileOrder(editPathEntry(oldSize.first).references, oldSize.second);
+    }
+    files_[fileIndex] = std::move(file);
 }
 
-const lsp::types::Position lsp::ArxmlStorage::getPositionFromOffset(const uint32_t offset, const uint32_t fileIndex) const
+void lsp::ArxmlStorage::removeFileElements(const uint32_t fileIndex)
 {
-    lsp::types::Position ret;
-    ret.line = std::lower_bound(
-        newlineOffsets_[fileIndex].begin(), newlineOffsets_[fileIndex].end(), offset
-    ) - newlineOffsets_[fileIndex].begin() - 1;
-    ret.character = offset - newlineOffsets_[fileIndex][ret.line];
-    return ret;
+    //Only the lists by path that contain elements of this file are touched, so removing a file doesn't depend on the size of the storage
+    const IndexedFile &file = *files_[fileIndex];
+    std::vector<uint32_t> elementPaths;
+    std::vector<uint32_t> childrenPaths;
+    std::vector<uint32_t> targetPaths;
+    {
+        std::shared_lock<std::shared_mutex> lock(pathTable_->mutex);
+        for (auto &element : file.shortnames)
+        {
+            elementPaths.push_back(element.pathId);
+            childrenPaths.push_back(pathTable_->pathIds.find(element.path)->second);
+        }
+    }
+    for (auto &reference : file.references)
+    {
+        targetPaths.push_back(reference.targetPathId);
+    }
+
+    auto isInFile = [fileIndex](auto element)
+    {
+        return element->fileIndex == fileIndex;
+    };
+    auto removeFromLists = [&](std::vector<uint32_t> &pathIds, auto list)
+    {
+        std::sort(pathIds.begin(), pathIds.end());
+        pathIds.erase(std::unique(pathIds.begin(), pathIds.end()), pathIds.end());
+        for (auto pathId : pathIds)
+        {
+            auto &elements = editPathEntry(pathId).*list;
+            elements.erase(std::remove_if(elements.begin(), elements.end(), isInFile), elements.end());
+        }
+    };
+    removeFromLists(elementPaths, &PathEntry::elements);
+    removeFromLists(childrenPaths, &PathEntry::children);
+    removeFromLists(targetPaths, &PathEntry::references);
 }
 
-std::string lsp::ShortnameElement::getFullPath() const
+uint32_t lsp::ArxmlStorage::internPath(const std::string_view path)
 {
-    if(path.length())
+    auto interned = pathTable_->pathIds.find(path);
+    if (interned != pathTable_->pathIds.end())
     {
-        return path + "/" + name;
+        return interned->second;
+    }
+    //The file that interns the path counts itself as its user once all of its paths are interned
+    uint32_t pathId;
+    if (!pathTable_->releasedIds.empty())
+    {
+        pathId = pathTable_->releasedIds.back();
+        pathTable_->releasedIds.pop_back();
+        pathTable_->paths[pathId] = path;
     }
     else
     {
-        return name;
+        pathId = pathTable_->paths.size();
+        pathTable_->paths.emplace_back(path);
+        pathTable_->users.push_back(0);
     }
+    pathTable_->pathIds.emplace(pathTable_->paths[pathId], pathId);
+    return pathId;
 }
 
-uint32_t lsp::ArxmlStorage::getFileIndex(std::string uri)
+lsp::ArxmlStorage::IndexedFile::~IndexedFile()
 {
-    for(uint32_t i = 0; i < URIs_.size(); i++)
+    //Placeholders that were never linked have no paths
+    if (!pathTable)
     {
-        if(!URIs_[i].compare(uri))
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(pathTable->mutex);
+    for (auto pathId : pathIds)
+    {
+        if (!--pathTable->users[pathId])
         {
-            return i;
+            pathTable->pathIds.erase(pathTable->paths[pathId]);
+            std::string().swap(pathTable->paths[pathId]);
+            pathTable->releasedIds.push_back(pathId);
         }
     }
+}
+
+uint32_t lsp::ArxmlStorage::getOffsetFromPosition(const lsp::types::Position &position, const uint32_t fileIndex) const
+{
+    return getFile(fileIndex).newlineOffsets[position.line] + position.character;
+}
+
+const lsp::types::Position lsp::ArxmlStorage::getPositionFromOffset(const uint32_t offset, const uint32_t fileIndex) const
+{
+    const std::vector<uint32_t> &newlineOffsets = getFile(fileIndex).newlineOffsets;
+    lsp::types::Position ret;
+    ret.line = std::lower_bound(
+        newlineOffsets.begin(), newlineOffsets.end(), offset
+    ) - newlineOffsets.begin() - 1;
+    ret.character = offset - newlineOffsets[ret.line];
+    return ret;
+}
+
+const std::string &lsp::ShortnameElement::getFullPath() const
+{
+    return *fullPath;
+}
+
+uint32_t lsp::ArxmlStorage::getFileIndex(const std::string &uri) const
+{
+    auto res = fileTable_->fileIndices.find(normalizeUri(uri));
+    if (res != fileTable_->fileIndices.end())
+    {
+        return res->second;
+    }
     throw lsp::elementNotFoundException();
 }
 
-void lsp::ArxmlStorage::addFileIndex(std::string uri)
+bool lsp::ArxmlStorage::containsFile(const std::string &uri) const
+{
+    return fileTable_->fileIndices.count(normalizeUri(uri)) != 0;
+}
+
+uint32_t lsp::ArxmlStorage::getFileCount() const
 {
-    URIs_.push_back(uri);
+    return files_.size();
 }
 
-bool lsp::ArxmlStorage::containsFile(std::string uri)
+uint64_t lsp::ArxmlStorage::getContentHash(const uint32_t fileIndex) const
 {
-    auto pos = std::find(std::begin(URIs_), std::end(URIs_), uri);
-    if (pos != std::end(URIs_)) {
-        return true;
+    return files_[fileIndex]->contentHash;
+}
+
+std::string lsp::ArxmlStorage::normalizeUri(const std::string_view uri)
+{
+    auto hexValue = [](const char c) -> int
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    std::string normalized;
+    normalized.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); i++)
+    {
+        char c = uri[i];
+        if (c == '%' && i + 2 < uri.size() && hexValue(uri[i + 1]) >= 0 && hexValue(uri[i + 2]) >= 0)
+        {
+            c = static_cast<char>(hexValue(uri[i + 1]) * 16 + hexValue(uri[i + 2]));
+            i += 2;
+        }
+        if (c == '\\')
+        {
+            c = '/';
+        }
+        normalized.push_back(c);
     }
-    return false;
+#ifdef _WIN32
+    //Paths on Windows are case insensitive
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return std::tolower(c); });
+#else
+    //Elsewhere files can differ by case only, so just the scheme and a drive letter, e.g. "file:///C:/", are case insensitive
+    const size_t schemeEnd = normalized.find("://");
+    if (schemeEnd != std::string::npos)
+    {
+        std::transform(normalized.begin(), normalized.begin() + schemeEnd, normalized.begin(), [](unsigned char c) { return std::tolower(c); });
+        const size_t pathBegin = normalized.find('/', schemeEnd + 3);
+        if (pathBegin != std::string::npos && pathBegin + 2 < normalized.size() && std::isalpha(static_cast<unsigned char>(normalized[pathBegin + 1]))
+            && normalized[pathBegin + 2] == ':')
+        {
+            normalized[pathBegin + 1] = std::tolower(static_cast<unsigned char>(normalized[pathBegin + 1]));
+        }
+    }
+#endif
+    return normalized;
 }
 
-std::string lsp::ArxmlStorage::getUriFromFileIndex(uint32_t fileIndex)
+std::string lsp::ArxmlStorage::getUriFromFileIndex(uint32_t fileIndex) const
 {
-    return URIs_[fileIndex];
-}
\ No newline at end of file
+    return files_[fileIndex]->uri;
+}
@@ -1,4 +1,18 @@
 #include "config.hpp"
 
-bool lsp::config::shutdown = false;
-bool lsp::config::referenceLinkToParentShortname = true;
\ No newline at end of file
+#include <mutex>
+
+static std::mutex settingsMutex;
+static lsp::config::IndexSettings indexSettings;
+
+lsp::config::IndexSettings lsp::config::getIndexSettings()
+{
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    return indexSettings;
+}
+
+void lsp::config::setIndexSettings(const IndexSettings &settings)
+{
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    indexSettings = settings;
+}
@@ -0,0 +1,109 @@
+#include "daemon.hpp"
+
+#include <iostream>
+#include <cstdio>
+
+#include "languageService.hpp"
+#include "lspExceptions.hpp"
+
+using namespace boost;
+
+lsp::Daemon::Daemon(uint32_t port)
+    : nextConnectionID_(0), indexRegistry_(std::make_shared<lsp::IndexRegistry>()), ioc_()
+{
+    //Only local clients, the protocol has no authentication
+    asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    tcpAcceptor_ = std::make_unique<asio::ip::tcp::acceptor>(ioc_, endpoint);
+    std::cout << "Listening on 127.0.0.1:" << port << "\n\n";
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+lsp::Daemon::Daemon(const std::string &socketPath)
+    : nextConnectionID_(0), indexRegistry_(std::make_shared<lsp::IndexRegistry>()), ioc_(), socketPath_(socketPath)
+{
+    std::remove(socketPath_.c_str());
+    unixAcceptor_ = std::make_unique<asio::local::stream_protocol::acceptor>(ioc_, asio::local::stream_protocol::endpoint(socketPath_));
+    std::cout << "Listening on " << socketPath_ << "\n\n";
+}
+#endif
+
+lsp::Daemon::~Daemon()
+{
+    tcpAcceptor_.reset();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (unixAcceptor_)
+    {
+        unixAcceptor_.reset();
+        std::remove(socketPath_.c_str());
+    }
+#endif
+    for (auto &connection : connections_)
+    {
+        connection.thread.join();
+    }
+}
+
+std::unique_ptr<lsp::Transport> lsp::Daemon::accept()
+{
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (unixAcceptor_)
+    {
+        return std::make_unique<lsp::UnixSocketTransport>(unixAcceptor_->accept());
+    }
+#endif
+    return std::make_unique<lsp::TcpTransport>(tcpAcceptor_->accept());
+}
+
+void lsp::Daemon::removeFinishedConnections()
+{
+    for (auto it = connections_.begin(); it != connections_.end(); )
+    {
+        if (*it->finished)
+        {
+            it->thread.join();
+            it = connections_.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void lsp::Daemon::run()
+{
+    while (true)
+    {
+        std::unique_ptr<lsp::Transport> transport;
+        try
+        {
+            transport = accept();
+        }
+        catch (const boost::system::system_error &e)
+        {
+            std::cout << "Could not accept clients anymore: " << e.what() << "\n\n";
+            return;
+        }
+        removeFinishedConnections();
+
+        const uint32_t connectionID = nextConnectionID_++;
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        std::cout << "Client " << connectionID << " connected, " << connections_.size() + 1 << " client(s)\n\n";
+        std::thread thread([this, connectionID, finished, transport = std::move(transport)]() mutable
+        {
+            try
+            {
+                lsp::LanguageService service(std::move(transport), indexRegistry_, false);
+                service.run();
+            }
+            catch (const std::exception &e)
+            {
+                //Only this client is lost, the others are served on
+                std::cout << "Client " << connectionID << " failed: " << e.what() << "\n\n";
+            }
+            std::cout << "Client " << connectionID << " disconnected\n\n";
+            *finished = true;
+        });
+        connections_.push_back({std::move(thread), finished});
+    }
+}
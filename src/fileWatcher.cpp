@@ -0,0 +1,186 @@
+#include "fileWatcher.hpp"
+
+#include <set>
+#include <iostream>
+
+#include "boost/filesystem.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+//How long the watcher sleeps at most without events, before it checks if it should stop
+static const std::chrono::milliseconds idleTimeout(100);
+//A burst is reported after this many debounce times even if the events don't stop, so a busy directory can't delay it forever
+static const uint32_t maxDebounceTimes = 10;
+
+lsp::FileWatcher::FileWatcher(const std::string &directory, const std::string &extension, changeCallback_t onChange, std::chrono::milliseconds debounceTime)
+    : directory_(directory), extension_(extension), onChange_(onChange), debounceTime_(debounceTime),
+      inotifyFd_(-1), watchDescriptor_(-1), running_(false), stop_(false),
+      eventsReceived_(0), bursts_(0), filesReindexed_(0), reindexMicroseconds_(0)
+{
+#ifdef __linux__
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0)
+    {
+        std::cout << "Could not watch " << directory_ << ", inotify is not available\n\n";
+        return;
+    }
+    //Written files are reported when they are closed, not for every write, so a file is only read once it is complete
+    watchDescriptor_ = inotify_add_watch(inotifyFd_, directory_.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (watchDescriptor_ < 0)
+    {
+        std::cout << "Could not watch " << directory_ << "\n\n";
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&FileWatcher::run, this);
+#endif
+}
+
+lsp::FileWatcher::~FileWatcher()
+{
+    stop_ = true;
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+#ifdef __linux__
+    if (inotifyFd_ >= 0)
+    {
+        close(inotifyFd_);
+    }
+#endif
+}
+
+lsp::FileWatcher::Statistics lsp::FileWatcher::getStatistics() const
+{
+    Statistics statistics;
+    statistics.eventsReceived = eventsReceived_;
+    statistics.bursts = bursts_;
+    statistics.filesReindexed = filesReindexed_;
+    statistics.reindexMicroseconds = reindexMicroseconds_;
+    return statistics;
+}
+
+bool lsp::FileWatcher::hasExtension(const std::string &fileName) const
+{
+    return fileName.size() >= extension_.size() && !fileName.compare(fileName.size() - extension_.size(), extension_.size(), extension_);
+}
+
+std::vector<std::string> lsp::FileWatcher::listDirectory() const
+{
+    std::vector<std::string> fileNames;
+    try
+    {
+        for (auto &entry : boost::filesystem::directory_iterator(directory_))
+        {
+            std::string fileName = entry.path().filename().string();
+            if (hasExtension(fileName))
+            {
+                fileNames.push_back(fileName);
+            }
+        }
+    }
+    catch (const boost::filesystem::filesystem_error &e)
+    {
+    }
+    return fileNames;
+}
+
+void lsp::FileWatcher::run()
+{
+#ifdef __linux__
+    typedef std::chrono::steady_clock clock;
+    std::set<std::string> pending;
+    bool rescan = false;
+    bool removed = false;
+    clock::time_point firstEvent;
+    clock::time_point lastEvent;
+    alignas(inotify_event) char buffer[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+
+    while (!stop_ && !removed)
+    {
+        std::chrono::milliseconds timeout = idleTimeout;
+        if (!pending.empty() || rescan)
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(debounceTime_ - (clock::now() - lastEvent));
+            timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, remaining));
+        }
+        pollfd pollFd = {inotifyFd_, POLLIN, 0};
+        if (poll(&pollFd, 1, timeout.count()) > 0 && (pollFd.revents & POLLIN))
+        {
+            ssize_t length;
+            while (!removed && (length = read(inotifyFd_, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *current = buffer; !removed && current < buffer + length; current += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(current)->len)
+                {
+                    const inotify_event *event = reinterpret_cast<inotify_event*>(current);
+                    const bool wasIdle = pending.empty() && !rescan;
+                    eventsReceived_++;
+                    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                    {
+                        //The files removed before the directory are still reported below
+                        std::cout << "Stopped watching " << directory_ << ", the directory was removed\n\n";
+                        removed = true;
+                    }
+                    else if (event->mask & IN_Q_OVERFLOW)
+                    {
+                        rescan = true;
+                    }
+                    else if (event->len && !(event->mask & IN_ISDIR) && hasExtension(event->name))
+                    {
+                        pending.insert(event->name);
+                    }
+                    else
+                    {
+                        continue;
+                    }
+                    lastEvent = clock::now();
+                    if (wasIdle)
+                    {
+                        firstEvent = lastEvent;
+                    }
+                }
+            }
+        }
+
+        const clock::time_point now = clock::now();
+        if ((!pending.empty() || rescan) && (removed || now - lastEvent >= debounceTime_ || now - firstEvent >= maxDebounceTimes * debounceTime_))
+        {
+            std::vector<std::string> fileNames;
+            if (rescan)
+            {
+                fileNames = listDirectory();
+            }
+            else
+            {
+                fileNames.assign(pending.begin(), pending.end());
+            }
+            auto t0 = clock::now();
+            uint32_t reindexed = 0;
+            try
+            {
+                reindexed = onChange_(fileNames, rescan);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Updating the changed files in " << directory_ << " failed: " << e.what() << "\n\n";
+            }
+            auto t1 = clock::now();
+            bursts_++;
+            filesReindexed_ += reindexed;
+            reindexMicroseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+            pending.clear();
+            rescan = false;
+        }
+    }
+#endif
+    running_ = false;
+}
@@ -0,0 +1,329 @@
+#include "indexCache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <string_view>
+#include <ctime>
+#include <cstdint>
+#include <stdexcept>
+
+#include "boost/filesystem.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
+
+//Bump this whenever the scanner or the layout changes, old cache files are then ignored and overwritten
+static const uint32_t cacheVersion = 3;
+static const char cacheMagic[8] = {'A', 'R', 'X', 'M', 'L', 'I', 'D', 'X'};
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t uriLength;
+    uint64_t fileSize;
+    int64_t modificationTime;
+    uint64_t contentHash;
+    uint32_t numNewlines;
+    uint32_t numShortnames;
+    uint32_t numReferences;
+    uint32_t flags;
+    uint64_t stringsSize;
+};
+
+//The file was modified so shortly before it was scanned that a later write could have kept the same modification time,
+//so the content hash is checked even if the modification time didn't change
+static const uint32_t flagRacy = 1;
+//Modification times are only exact to a second (two on FAT), a file written this recently when it is scanned is racy
+static const int64_t racyWindow = 2;
+
+//Strings are stored as offset and length into the string block at the end of the cache file.
+//The path of a shortname is stored once per file and shared by all elements with that path, so loading doesn't have to build it
+struct CachedShortname
+{
+    uint32_t name;
+    uint32_t nameLength;
+    uint32_t path;
+    uint32_t pathLength;
+    uint32_t charOffset;
+    int32_t parent;
+};
+
+struct CachedReference
+{
+    uint32_t name;
+    uint32_t nameLength;
+    uint32_t targetPath;
+    uint32_t targetPathLength;
+    uint32_t charOffset;
+    int32_t owner;
+};
+
+template <typename T>
+void helper_append(std::string &buffer, const T &value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//Throws std::length_error if the block would outgrow the 32 bit offsets, such a file is not cached
+uint32_t helper_appendString(std::string &strings, const std::string &value)
+{
+    if (strings.size() + value.size() > UINT32_MAX)
+    {
+        throw std::length_error("String block of the index cache file is too large");
+    }
+    uint32_t offset = strings.size();
+    strings += value;
+    return offset;
+}
+
+lsp::IndexCache::IndexCache(const std::string &directory)
+    : directory_(directory), enabled_(false)
+{
+    if (directory_.empty())
+    {
+        return;
+    }
+    try
+    {
+        boost::filesystem::create_directories(directory_);
+        enabled_ = boost::filesystem::is_directory(directory_);
+    }
+    catch (const boost::filesystem::filesystem_error &e)
+    {
+        enabled_ = false;
+    }
+}
+
+std::string lsp::IndexCache::getCacheFilePath(const std::string &uri) const
+{
+    const std::string normalizedUri = ArxmlStorage::normalizeUri(uri);
+    std::ostringstream fileName;
+    fileName << std::hex << std::setw(16) << std::setfill('0') << hashContent(normalizedUri.data(), normalizedUri.size()) << ".idx";
+    return (boost::filesystem::path(directory_) / fileName.str()).string();
+}
+
+uint64_t lsp::IndexCache::hashContent(const char *content, uint64_t size)
+{
+    //Four independent lanes, so the multiplications of neighbouring words don't wait for each other
+    const uint64_t multiplier = 0xFF51AFD7ED558CCDULL;
+    uint64_t lanes[4] = {0x9E3779B97F4A7C15ULL ^ size, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x27D4EB2F165667C5ULL};
+    uint64_t position = 0;
+    for (; position + 32 <= size; position += 32)
+    {
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            uint64_t word;
+            memcpy(&word, content + position + 8 * lane, 8);
+            lanes[lane] = (lanes[lane] ^ word) * multiplier;
+            lanes[lane] ^= lanes[lane] >> 32;
+        }
+    }
+    uint64_t hash = lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+    for (; position < size; position += 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, content + position, std::min<uint64_t>(8, size - position));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+bool lsp::IndexCache::load(const std::string &uri, const std::string &filePath, StagedFile &file) const
+{
+    if (!enabled_)
+    {
+        return false;
+    }
+    try
+    {
+        const std::string cacheFilePath = getCacheFilePath(uri);
+        if (!boost::filesystem::exists(cacheFilePath))
+        {
+            return false;
+        }
+        const uint64_t fileSize = boost::filesystem::file_size(filePath);
+        const int64_t modificationTime = boost::filesystem::last_write_time(filePath);
+
+        boost::iostreams::mapped_file_source cache(cacheFilePath);
+        const char *current = cache.data();
+
+        CacheHeader header;
+        if (cache.size() < sizeof(CacheHeader))
+        {
+            return false;
+        }
+        memcpy(&header, current, sizeof(CacheHeader));
+        current += sizeof(CacheHeader);
+        if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) || header.version != cacheVersion || header.fileSize != fileSize)
+        {
+            return false;
+        }
+        const uint64_t expectedSize = sizeof(CacheHeader) + header.uriLength + header.numNewlines * sizeof(uint32_t)
+            + header.numShortnames * sizeof(CachedShortname) + header.numReferences * sizeof(CachedReference) + header.stringsSize;
+        if (cache.size() != expectedSize || ArxmlStorage::normalizeUri(std::string_view(current, header.uriLength)) != ArxmlStorage::normalizeUri(uri))
+        {
+            return false;
+        }
+        current += header.uriLength;
+
+        bool touched = false;
+        if (header.modificationTime != modificationTime || (header.flags & flagRacy))
+        {
+            //The file was written since, but might still have the same content
+            if (fileSize)
+            {
+                boost::iostreams::mapped_file_source source(filePath);
+                if (hashContent(source.data(), source.size()) != header.contentHash)
+                {
+                    return false;
+                }
+            }
+            touched = true;
+        }
+
+        file.uri = uri;
+        file.contentHash = header.contentHash;
+        file.newlineOffsets.resize(header.numNewlines);
+        memcpy(file.newlineOffsets.data(), current, header.numNewlines * sizeof(uint32_t));
+        current += header.numNewlines * sizeof(uint32_t);
+
+        const char *const shortnames = current;
+        const char *const references = shortnames + header.numShortnames * sizeof(CachedShortname);
+        const char *const strings = references + header.numReferences * sizeof(CachedReference);
+        auto getString = [&](uint32_t offset, uint32_t length)
+        {
+            if (offset + static_cast<uint64_t>(length) > header.stringsSize)
+            {
+                throw std::out_of_range("String outside of the index cache file");
+            }
+            return std::string(strings + offset, length);
+        };
+
+        file.shortnames.resize(header.numShortnames);
+        for (uint32_t i = 0; i < header.numShortnames; i++)
+        {
+            CachedShortname cached;
+            memcpy(&cached, shortnames + i * sizeof(CachedShortname), sizeof(CachedShortname));
+            StagedShortname &shortname = file.shortnames[i];
+            shortname.name = getString(cached.name, cached.nameLength);
+            shortname.path = getString(cached.path, cached.pathLength);
+            shortname.charOffset = cached.charOffset;
+            //Parents are always scanned before their children
+            shortname.parent = cached.parent < static_cast<int32_t>(i) ? cached.parent : -1;
+        }
+        file.references.resize(header.numReferences);
+        for (uint32_t i = 0; i < header.numReferences; i++)
+        {
+            CachedReference cached;
+            memcpy(&cached, references + i * sizeof(CachedReference), sizeof(CachedReference));
+            StagedReference &reference = file.references[i];
+            reference.name = getString(cached.name, cached.nameLength);
+            reference.targetPath = getString(cached.targetPath, cached.targetPathLength);
+            reference.charOffset = cached.charOffset;
+            reference.owner = cached.owner < static_cast<int32_t>(header.numShortnames) ? cached.owner : -1;
+        }
+        cache.close();
+
+        //Remember the new modification time, so the content doesn't have to be hashed again next time
+        if (touched)
+        {
+            header.modificationTime = modificationTime;
+            if (std::time(nullptr) - modificationTime >= racyWindow)
+            {
+                header.flags &= ~flagRacy;
+            }
+            std::fstream stream(cacheFilePath, std::ios::in | std::ios::out | std::ios::binary);
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        file = StagedFile();
+        return false;
+    }
+}
+
+void lsp::IndexCache::store(const StagedFile &file, int64_t modificationTime, uint64_t size) const
+{
+    if (!enabled_)
+    {
+        return;
+    }
+    try
+    {
+        const std::string normalizedUri = ArxmlStorage::normalizeUri(file.uri);
+        CacheHeader header;
+        memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = cacheVersion;
+        header.uriLength = normalizedUri.size();
+        header.fileSize = size;
+        header.modificationTime = modificationTime;
+        header.contentHash = file.contentHash;
+        header.numNewlines = file.newlineOffsets.size();
+        header.numShortnames = file.shortnames.size();
+        header.numReferences = file.references.size();
+        header.flags = std::time(nullptr) - modificationTime < racyWindow ? flagRacy : 0;
+
+        std::string records;
+        std::string strings;
+        records.reserve(header.numShortnames * sizeof(CachedShortname) + header.numReferences * sizeof(CachedReference));
+        //Most elements share their path with their siblings
+        std::unordered_map<std::string_view, uint32_t> pathOffsets;
+        for (auto &shortname : file.shortnames)
+        {
+            CachedShortname cached;
+            cached.name = helper_appendString(strings, shortname.name);
+            cached.nameLength = shortname.name.size();
+            auto pathOffset = pathOffsets.find(shortname.path);
+            if (pathOffset == pathOffsets.end())
+            {
+                pathOffset = pathOffsets.emplace(shortname.path, helper_appendString(strings, shortname.path)).first;
+            }
+            cached.path = pathOffset->second;
+            cached.pathLength = shortname.path.size();
+            cached.charOffset = shortname.charOffset;
+            cached.parent = shortname.parent;
+            helper_append(records, cached);
+        }
+        for (auto &reference : file.references)
+        {
+            CachedReference cached;
+            cached.name = helper_appendString(strings, reference.name);
+            cached.nameLength = reference.name.size();
+            cached.targetPath = helper_appendString(strings, reference.targetPath);
+            cached.targetPathLength = reference.targetPath.size();
+            cached.charOffset = reference.charOffset;
+            cached.owner = reference.owner;
+            helper_append(records, cached);
+        }
+        header.stringsSize = strings.size();
+
+        //Write to a temporary file first, so a server starting at the same time never maps a half written file
+        const std::string cacheFilePath = getCacheFilePath(file.uri);
+        //Random name, so neither other threads nor other server processes, e.g. a daemon next to a stdio instance, write to the same one
+        const boost::filesystem::path temporaryPath = boost::filesystem::unique_path(cacheFilePath + ".%%%%-%%%%-%%%%-%%%%.tmp");
+        {
+            std::ofstream stream(temporaryPath.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+            stream.write(normalizedUri.data(), normalizedUri.size());
+            stream.write(reinterpret_cast<const char*>(file.newlineOffsets.data()), file.newlineOffsets.size() * sizeof(uint32_t));
+            stream.write(records.data(), records.size());
+            stream.write(strings.data(), strings.size());
+            if (!stream)
+            {
+                stream.close();
+                boost::filesystem::remove(temporaryPath);
+                return;
+            }
+        }
+        boost::filesystem::rename(temporaryPath, cacheFilePath);
+    }
+    catch (const std::exception &e)
+    {
+        //Not being able to write the cache only costs time on the next start
+    }
+}
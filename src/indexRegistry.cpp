@@ -0,0 +1,27 @@
+#include "indexRegistry.hpp"
+
+#include <iostream>
+
+std::shared_ptr<lsp::XmlParser> lsp::IndexRegistry::acquire(const std::string &root)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::weak_ptr<lsp::XmlParser> &entry = indexes_[root];
+    std::shared_ptr<lsp::XmlParser> index = entry.lock();
+    if (index)
+    {
+        std::cout << "Sharing the index of \"" << root << "\" with " << index.use_count() - 1 << " other client(s)\n\n";
+        return index;
+    }
+    index = std::make_shared<lsp::XmlParser>();
+    entry = index;
+
+    //Forget the workspaces nobody has open anymore
+    for (auto it = indexes_.begin(); it != indexes_.end(); )
+    {
+        if (it->second.expired())
+            it = indexes_.erase(it);
+        else
+            it++;
+    }
+    return index;
+}
@@ -2,124 +2,197 @@
 
 #include <iostream>
 #include <string>
-#include <thread>
-#include <chrono>
-
-#include "boost/asio.hpp"
-#include "boost/lexical_cast.hpp"
-
-using namespace boost;
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+
+#include "lspExceptions.hpp"
+
+//Big enough for every request except opening or changing a document
+static const size_t initialReadBufferSize = 64 * 1024;
+static const size_t maxIdleReadBufferSize = 4 * 1024 * 1024;
+
+lsp::IOHandler::IOHandler(std::unique_ptr<lsp::Transport> transport)
+    : readBuffer_(initialReadBufferSize), readBegin_(0), readEnd_(0), headerLength_(0), contentLength_(0), headerSearchOffset_(0), stopWriter_(false),
+      transport_(std::move(transport))
+{
+    writer_ = std::thread(&IOHandler::runWriter_, this);
+}
 
-lsp::IOHandler::IOHandler(const std::string &address, uint32_t port)
-    : ioc_(), endpoint_(asio::ip::address::from_string(address), port), socket_(ioc_, endpoint_.protocol())
+lsp::IOHandler::~IOHandler()
 {
-    std::cout << "Connecting to " << address << ":" << port << "...\n";
-    socket_.connect(endpoint_);
-    std::cout << "Connection established\n";
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        stopWriter_ = true;
+    }
+    messagesToWrite_.notify_one();
+    writer_.join();
 }
 
-void lsp::IOHandler::addMessageToSend(const std::string &message)
+void lsp::IOHandler::addMessageToSend(std::string message)
 {
-    sendStack_.emplace(message);
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    sendQueue_.push_back(std::move(message));
 }
 
 std::string lsp::IOHandler::readNextMessage()
 {
     std::string ret;
-    if (read_(ret))
-    {
+    read_(ret);
 #ifndef NO_TERMINAL_OUTPUT
-        std::cout << " >> Receiving Message:\n" << ret << "\n\n";
+    std::cout << " >> Receiving Message:\n" << ret << "\n\n";
 #endif
-        return ret;
-    }
-    else
+    return ret;
+}
+
+void lsp::IOHandler::writeAllMessages()
+{
     {
-        return "";
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        if (sendQueue_.empty())
+            return;
+        std::move(sendQueue_.begin(), sendQueue_.end(), std::back_inserter(writeQueue_));
+        sendQueue_.clear();
     }
+    messagesToWrite_.notify_one();
 }
 
-void lsp::IOHandler::writeAllMessages()
+void lsp::IOHandler::runWriter_()
 {
-    while(!sendStack_.empty())
+    std::deque<std::string> messages;
+    while (true)
     {
-        std::string toSend = sendStack_.top();
-        sendStack_.pop();
-        write_(toSend);
+        {
+            std::unique_lock<std::mutex> lock(sendMutex_);
+            messagesToWrite_.wait(lock, [this]() { return stopWriter_ || !writeQueue_.empty(); });
+            //Messages handed over before stopping are still sent
+            if (writeQueue_.empty())
+                return;
+            //Everything that piled up during the last write goes out in the next one
+            messages.swap(writeQueue_);
+        }
+        try
+        {
+            write_(messages);
+        }
+        catch (const boost::system::system_error &e)
+        {
+            //The client is gone, the read loop notices it too
+            std::cerr << "Could not send " << messages.size() << " messages: " << e.what() << std::endl;
+        }
 #ifndef NO_TERMINAL_OUTPUT
-        if(toSend.size() > (1024*5)) //5kb write limit to console
-            std::cout << " >> Sending Message:\n" << toSend.substr(0, 1024*5) << "\n>> Console Write limit reached. The write to the socket was unaffected, this is to prevent the console from crashing.\n\n";
-        else
-            std::cout << " >> Sending Message:\n" << toSend << "\n\n";
+        for (auto &toSend : messages)
+        {
+            if(toSend.size() > (1024*5)) //5kb write limit to console
+                std::cout << " >> Sending Message:\n" << toSend.substr(0, 1024*5) << "\n>> Console Write limit reached. The write to the client was unaffected, this is to prevent the console from crashing.\n\n";
+            else
+                std::cout << " >> Sending Message:\n" << toSend << "\n\n";
+        }
 #endif
+        messages.clear();
     }
 }
 
-std::size_t lsp::IOHandler::read_(std::string &message)
+bool lsp::IOHandler::parseHeader_()
 {
-    while(socket_.available() < 30)
+    static constexpr std::string_view headerEnd = "\r\n\r\n";
+    static constexpr std::string_view lengthField = "content-length";
+    const std::string_view unread(readBuffer_.data() + readBegin_, readEnd_ - readBegin_);
+    const size_t end = unread.find(headerEnd, headerSearchOffset_);
+    if (end == std::string_view::npos)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        //The end of the header might already be partly in the buffer
+        headerSearchOffset_ = unread.size() >= headerEnd.size() ? unread.size() - headerEnd.size() + 1 : 0;
+        return false;
     }
+    headerLength_ = end + headerEnd.size();
+    headerSearchOffset_ = 0;
+    contentLength_ = 0;
+    bool foundLength = false;
 
-    /////////////////////////// Header ///////////////////////////
-
-    //read_until() and read() are incompatible, as read_until can read over the delimiter, when calling consecutive
-    //read_until()s, it looks into the buffer first if the condition is already met, so it does not read from the socket in that case
-    //read does not look at the buffer, so it will probably miss a majority of the content, as that is in the buffer.
-    //for this reason, the streambuffer for the header is limited to 30 characters, 20 for the "Content-Lenght: " and "\r\n\r\n"
-    //and 10 characters for the number, as requests should not be bigger than that anyways.
-    //This is necessary because the header is delimited by a string delimiter, while the body is delmitited by the provided length
-    //read_until() for the delimiter, read() for the fixed length
-    asio::streambuf headerbuf(30);
-    boost::system::error_code ec;
-
-    std::size_t headerLength = asio::read_until(socket_, headerbuf, "\r\n\r\n", ec);
-    if (ec) { std::cerr << ec.message() << std::endl; }
-
-    size_t contentLength = lexical_cast<size_t>(std::string{
-        // Remove the "Content-Length: "
-        asio::buffers_begin(headerbuf.data()) + 16,
-        // Remove the "\r\n\r\n"
-        asio::buffers_begin(headerbuf.data()) + headerLength - 4
-    });
-
-    headerbuf.consume(headerLength);
-
-    //We didn't know how big the header was before, so we have probably had too much space in the streambuffer, some of the content might still be here
-    //We can extract that now and continue reading with read, since we know exactly how much read_until() read.
-    std::istream headerStream(&headerbuf);
-    std::string contentInHeader;
-    headerStream >> contentInHeader;
-
-    /////////////////////////// Content //////////////////////////
-    asio::streambuf contentbuf(contentLength - contentInHeader.size());
-
-    //read the rest
-    asio::read(socket_, contentbuf, asio::transfer_exactly(contentLength - contentInHeader.size()), ec);
-    if (ec) { std::cerr << ec.message() << std::endl;} 
-
-    message.reserve(contentLength);
-    message = contentInHeader + std::string{
-        asio::buffers_begin(contentbuf.data()),
-        asio::buffers_end(contentbuf.data())
-    };
+    //Every field is "name: value\r\n", only Content-Length matters, Content-Type is always utf-8 JSON-RPC
+    for (size_t lineStart = 0; lineStart < end; )
+    {
+        size_t lineEnd = std::min(unread.find("\r\n", lineStart), end);
+        const std::string_view line = unread.substr(lineStart, lineEnd - lineStart);
+        const size_t colon = line.find(':');
+        if (colon == lengthField.size() && std::equal(lengthField.begin(), lengthField.end(), line.begin(),
+            [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }))
+        {
+            size_t valueStart = colon + 1;
+            while (valueStart < line.size() && line[valueStart] == ' ')
+                valueStart++;
+            foundLength = std::from_chars(line.data() + valueStart, line.data() + line.size(), contentLength_).ec == std::errc();
+        }
+        lineStart = lineEnd + 2;
+    }
+    if (!foundLength)
+    {
+        //Without a length the body can't be found, the empty message is then rejected by the parser
+        std::cerr << "Received a header without Content-Length\n";
+        contentLength_ = 0;
+    }
+    return true;
+}
 
-    contentbuf.consume(contentLength);
+std::size_t lsp::IOHandler::read_(std::string &message)
+{
+    //Read until the header is complete and the whole body is in the buffer
+    while (!(headerLength_ || parseHeader_()) || readEnd_ - readBegin_ < headerLength_ + contentLength_)
+    {
+        if (readEnd_ == readBuffer_.size())
+        {
+            //Make room at the end: move the unread data to the front, and grow the buffer if the message still doesn't fit
+            const size_t unread = readEnd_ - readBegin_;
+            std::memmove(readBuffer_.data(), readBuffer_.data() + readBegin_, unread);
+            readBegin_ = 0;
+            readEnd_ = unread;
+            const size_t needed = headerLength_ ? headerLength_ + contentLength_ : unread + 1;
+            if (needed > readBuffer_.size())
+            {
+                readBuffer_.resize(std::max(needed, readBuffer_.size() * 2));
+            }
+        }
+
+        //Blocks until there is data, and takes everything that arrived up to the size of the buffer
+        readEnd_ += transport_->readSome(readBuffer_.data() + readEnd_, readBuffer_.size() - readEnd_);
+    }
 
-    return headerLength + contentLength;
+    message.assign(readBuffer_.data() + readBegin_ + headerLength_, contentLength_);
+    const size_t messageLength = headerLength_ + contentLength_;
+    readBegin_ += messageLength;
+    headerLength_ = 0;
+    if (readBegin_ == readEnd_)
+    {
+        readBegin_ = readEnd_ = 0;
+        //Don't keep the memory of a huge message, like a didOpen of a big file, around
+        if (readBuffer_.size() > maxIdleReadBufferSize)
+        {
+            readBuffer_.resize(initialReadBufferSize);
+            readBuffer_.shrink_to_fit();
+        }
+    }
+    return messageLength;
 }
 
-std::size_t lsp::IOHandler::write_(const std::string &message)
+std::size_t lsp::IOHandler::write_(const std::deque<std::string> &messages)
 {
-    asio::streambuf sendBuf;
-    std::ostream sendStream(&sendBuf);
-
-    sendStream << "Content-Length: ";
-    sendStream << lexical_cast<std::string>(message.length());
-    sendStream << "\r\n\r\n";
-    sendStream << message;
+    //Reserved up front, the buffers point into the headers
+    std::vector<std::string> headers;
+    std::vector<asio::const_buffer> buffers;
+    headers.reserve(messages.size());
+    buffers.reserve(messages.size() * 2);
+    for (auto &message : messages)
+    {
+        headers.push_back("Content-Length: " + std::to_string(message.length()) + "\r\n\r\n");
+        buffers.push_back(asio::buffer(headers.back()));
+        buffers.push_back(asio::buffer(message));
+    }
 
-    size_t sentBytes = asio::write(socket_, sendBuf);
-    return sentBytes;
+    transport_->write(buffers);
+    return std::accumulate(buffers.begin(), buffers.end(), size_t(0), [](size_t sum, const asio::const_buffer &buffer) { return sum + buffer.size(); });
 }
\ No newline at end of file
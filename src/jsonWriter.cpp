@@ -0,0 +1,168 @@
+#include "jsonWriter.hpp"
+
+#include <charconv>
+
+lsp::JsonWriter::JsonWriter(std::string &out)
+    : out_(out)
+{
+}
+
+void lsp::JsonWriter::writeString(std::string_view value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    out_ += '"';
+    //Copy the characters that need no escaping in one piece, that is almost all of them in URIs and paths
+    size_t unescapedStart = 0;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        const unsigned char character = value[i];
+        if (character >= 0x20 && character != '"' && character != '\\')
+            continue;
+        out_.append(value.data() + unescapedStart, i - unescapedStart);
+        unescapedStart = i + 1;
+        switch (character)
+        {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                out_ += "\\u00";
+                out_ += hexDigits[character >> 4];
+                out_ += hexDigits[character & 0xF];
+        }
+    }
+    out_.append(value.data() + unescapedStart, value.size() - unescapedStart);
+    out_ += '"';
+}
+
+void lsp::JsonWriter::writeUInt(uint64_t value)
+{
+    char buffer[20];
+    out_.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+void lsp::JsonWriter::writeBool(bool value)
+{
+    out_ += value ? "true" : "false";
+}
+
+void lsp::JsonWriter::write(const lsp::types::Position &position)
+{
+    out_ += "{\"character\":";
+    writeUInt(position.character);
+    out_ += ",\"line\":";
+    writeUInt(position.line);
+    out_ += '}';
+}
+
+void lsp::JsonWriter::write(const lsp::types::Range &range)
+{
+    out_ += "{\"end\":";
+    write(range.end);
+    out_ += ",\"start\":";
+    write(range.start);
+    out_ += '}';
+}
+
+void lsp::JsonWriter::write(const lsp::types::Location &location)
+{
+    out_ += "{\"range\":";
+    write(location.range);
+    out_ += ",\"uri\":";
+    writeString(location.uri);
+    out_ += '}';
+}
+
+void lsp::JsonWriter::write(const lsp::types::non_standard::ShortnameTreeElement &element)
+{
+    out_ += "{\"cState\":";
+    writeUInt(element.cState);
+    out_ += ",\"name\":";
+    writeString(element.name);
+    out_ += ",\"path\":";
+    writeString(element.path);
+    out_ += ",\"pos\":";
+    write(element.pos);
+    out_ += ",\"unique\":";
+    writeBool(element.unique);
+    out_ += ",\"uri\":";
+    writeString(element.uri);
+    out_ += '}';
+}
+
+//Upper bound of the characters of an element besides its strings, so the message is allocated once
+size_t helper_estimateSize(const lsp::types::Location &location)
+{
+    return location.uri.size() + 96;
+}
+
+size_t helper_estimateSize(const lsp::types::non_standard::ShortnameTreeElement &element)
+{
+    return element.name.size() + element.path.size() + element.uri.size() + 96;
+}
+
+template <typename T>
+std::shared_ptr<lsp::SerializedResponse> helper_serializeArray(const jsonrpcpp::Id &id, const std::vector<T> &results, const lsp::CancellationToken &token)
+{
+    //Same layout as jsonrpcpp::Response::to_json().dump()
+    const std::string prefix = "{\"id\":" + id.to_json().dump() + ",\"jsonrpc\":\"2.0\",\"result\":[";
+    size_t size = prefix.size() + 2;
+    for (auto &result : results)
+    {
+        size += helper_estimateSize(result);
+    }
+    std::string message;
+    message.reserve(size);
+    message += prefix;
+    lsp::JsonWriter writer(message);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (!(i & 1023))
+        {
+            token.throwIfCancelled();
+        }
+        if (i)
+        {
+            message += ',';
+        }
+        writer.write(results[i]);
+    }
+    message += "]}";
+    return std::make_shared<lsp::SerializedResponse>(id, std::move(message));
+}
+
+lsp::SerializedResponse::SerializedResponse(const jsonrpcpp::Id &id, std::string message)
+    : jsonrpcpp::Response(id, nlohmann::json(nullptr)), message_(std::move(message))
+{
+}
+
+nlohmann::json lsp::SerializedResponse::to_json() const
+{
+    return nlohmann::json::parse(message_);
+}
+
+std::string lsp::SerializedResponse::takeMessage(const jsonrpcpp::response_ptr &response)
+{
+    auto serialized = std::dynamic_pointer_cast<SerializedResponse>(response);
+    if (serialized)
+    {
+        return std::move(serialized->message_);
+    }
+    return response->to_json().dump();
+}
+
+std::shared_ptr<lsp::SerializedResponse> lsp::SerializedResponse::fromArray(const jsonrpcpp::Id &id, const std::vector<lsp::types::Location> &results,
+    const CancellationToken &token)
+{
+    return helper_serializeArray(id, results, token);
+}
+
+std::shared_ptr<lsp::SerializedResponse> lsp::SerializedResponse::fromArray(const jsonrpcpp::Id &id,
+    const std::vector<lsp::types::non_standard::ShortnameTreeElement> &results, const CancellationToken &token)
+{
+    return helper_serializeArray(id, results, token);
+}
@@ -2,34 +2,64 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
 
 #include "types.hpp"
 #include "lspExceptions.hpp"
 #include "config.hpp"
+#include "jsonWriter.hpp"
 
 
-void lsp::LanguageService::start(std::string address, uint32_t port)
+void lsp::LanguageService::start(std::unique_ptr<lsp::Transport> transport)
 {
-    ioHandler_ = std::make_shared<lsp::IOHandler>(address, port);
+    lsp::LanguageService service(std::move(transport), std::make_shared<lsp::IndexRegistry>(), true);
+    service.run();
+}
+
+lsp::LanguageService::LanguageService(std::unique_ptr<lsp::Transport> transport, std::shared_ptr<lsp::IndexRegistry> indexRegistry, bool exclusiveIndex)
+    : indexRegistry_(indexRegistry), exclusiveIndex_(exclusiveIndex), shutdown_(false), nextRequestID_(0), referenceLinkToParentShortname_(true)
+{
+    using namespace std::placeholders;
+    ioHandler_ = std::make_shared<lsp::IOHandler>(std::move(transport));
     messageParser_ = std::make_shared<lsp::MessageParser>();
-    xmlParser_ = std::make_shared<XmlParser>();
+    requestExecutor_ = std::make_shared<lsp::RequestExecutor>(0);
+
+    //Requests that only read the index are answered on the executor, and each response is sent as soon as it is ready.
+    //Notifications and everything that changes the state of the server are still handled by the main loop in the order they arrive
+    messageParser_->set_request_executor(requestExecutor_, [this](jsonrpcpp::response_ptr response)
+    {
+        ioHandler_->addMessageToSend(lsp::SerializedResponse::takeMessage(response));
+        ioHandler_->writeAllMessages();
+    });
 
     //register Callbacks here
-    messageParser_->register_notification_callback("initialized", lsp::LanguageService::notification_initialized);
-    messageParser_->register_notification_callback("exit", lsp::LanguageService::notification_exit);
-    messageParser_->register_notification_callback("workspace/didChangeConfiguration", lsp::LanguageService::notification_workspace_didChangeConfiguration);
-    messageParser_->register_request_callback("initialize", lsp::LanguageService::request_initialize);
-    messageParser_->register_request_callback("shutdown", lsp::LanguageService::request_shutdown);
-    messageParser_->register_request_callback("textDocument/definition", lsp::LanguageService::request_textDocument_definition);
-    messageParser_->register_request_callback("textDocument/references", lsp::LanguageService::request_textDocument_references);
-    messageParser_->register_request_callback("textDocument/hover", lsp::LanguageService::request_textDocument_hover);
-    messageParser_->register_request_callback("treeView/getChildren", lsp::LanguageService::request_treeView_getChildren);
-    messageParser_->register_request_callback("textDocument/goToOwner", lsp::LanguageService::request_textDocument_owner);
-    messageParser_->register_request_callback("treeView/getNearestShortname", lsp::LanguageService::request_treeView_getNearestShortname);
-    messageParser_->register_request_callback("treeView/getParentElement", lsp::LanguageService::request_treeView_getParentElement);
-
-    //begin the main run loop
-    run();
+    messageParser_->register_notification_callback("initialized", std::bind(&LanguageService::notification_initialized, this, _1));
+    messageParser_->register_notification_callback("exit", std::bind(&LanguageService::notification_exit, this, _1));
+    messageParser_->register_notification_callback("workspace/didChangeConfiguration", std::bind(&LanguageService::notification_workspace_didChangeConfiguration, this, _1));
+    messageParser_->register_notification_callback("textDocument/didOpen", std::bind(&LanguageService::notification_textDocument_didOpen, this, _1));
+    messageParser_->register_notification_callback("textDocument/didChange", std::bind(&LanguageService::notification_textDocument_didChange, this, _1));
+    messageParser_->register_notification_callback("textDocument/didSave", std::bind(&LanguageService::notification_textDocument_didSave, this, _1));
+    messageParser_->register_notification_callback("textDocument/didClose", std::bind(&LanguageService::notification_textDocument_didClose, this, _1));
+    messageParser_->register_notification_callback("$/cancelRequest", std::bind(&LanguageService::notification_cancelRequest, this, _1));
+    messageParser_->register_request_callback("initialize", std::bind(&LanguageService::request_initialize, this, _1, _2));
+    messageParser_->register_request_callback("shutdown", std::bind(&LanguageService::request_shutdown, this, _1, _2));
+    messageParser_->register_concurrent_request_callback("textDocument/definition", std::bind(&LanguageService::request_textDocument_definition, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("textDocument/references", std::bind(&LanguageService::request_textDocument_references, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("textDocument/hover", std::bind(&LanguageService::request_textDocument_hover, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("treeView/getChildren", std::bind(&LanguageService::request_treeView_getChildren, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("textDocument/goToOwner", std::bind(&LanguageService::request_textDocument_owner, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("treeView/getNearestShortname", std::bind(&LanguageService::request_treeView_getNearestShortname, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("treeView/getParentElement", std::bind(&LanguageService::request_treeView_getParentElement, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("workspace/getWatcherStatistics", std::bind(&LanguageService::request_workspace_getWatcherStatistics, this, _1, _2, _3));
+    messageParser_->register_concurrent_request_callback("workspace/getCancellationStatistics", std::bind(&LanguageService::request_workspace_getCancellationStatistics, this, _1, _2, _3));
+}
+
+lsp::LanguageService::~LanguageService()
+{
+    //The message parser shares the executor, its requests use everything below, so they have to be done before anything is destroyed
+    requestExecutor_->waitUntilIdle();
 }
 
 void lsp::LanguageService::run()
@@ -40,16 +70,17 @@ void lsp::LanguageService::run()
         {
             std::string message = ioHandler_->readNextMessage();
             jsonrpcpp::entity_ptr ret = messageParser_->parse(message);
-            if(lsp::config::shutdown)
+            if(shutdown_)
             {
-                //Stop the server
+                //Stop the server, requests that are still running are answered first
+                requestExecutor_->waitUntilIdle();
                 break;
             }
             if(ret)
             {
                 if(ret->is_response())
                 {
-                    ioHandler_->addMessageToSend(std::dynamic_pointer_cast<jsonrpcpp::Response>(ret)->to_json().dump());
+                    ioHandler_->addMessageToSend(lsp::SerializedResponse::takeMessage(std::dynamic_pointer_cast<jsonrpcpp::Response>(ret)));
                 }
             }
             ioHandler_->writeAllMessages();
@@ -58,41 +89,198 @@ void lsp::LanguageService::run()
         {
 
         }
+        catch (lsp::connectionClosedException &e)
+        {
+            //The client is gone without sending exit, nobody is left to answer
+            std::cout << "Connection closed by the client\n";
+            requestExecutor_->waitUntilIdle();
+            break;
+        }
+        catch (const std::exception &e)
+        {
+            //A message the server can't handle, e.g. a notification before initialize, only fails itself,
+            //in daemon mode the other clients are served by the same process
+            std::cout << "Could not handle message: " << e.what() << "\n\n";
+        }
     }
 }
 
-uint32_t getNextRequestID()
+uint32_t lsp::LanguageService::getRequestID()
 {
-    static uint32_t id = 0;
-    return id++;
+    return nextRequestID_++;
+}
+
+std::shared_ptr<lsp::XmlParser> lsp::LanguageService::getIndex()
+{
+    std::shared_ptr<XmlParser> index = std::atomic_load(&xmlParser_);
+    if (!index)
+    {
+        //Not initialized yet, there is nothing to answer from
+        throw lsp::elementNotFoundException();
+    }
+    return index;
+}
+
+//Workspace folders from the initialize request, normalized and sorted, so clients with the same folders share one index
+std::string helper_getWorkspaceRoot(const json &params)
+{
+    std::vector<std::string> folders;
+    if (params.contains("workspaceFolders") && params["workspaceFolders"].is_array())
+    {
+        for (auto &folder : params["workspaceFolders"])
+        {
+            folders.push_back(lsp::ArxmlStorage::normalizeUri(folder.at("uri").get_ref<const std::string&>()));
+        }
+    }
+    else if (params.contains("rootUri") && params["rootUri"].is_string())
+    {
+        folders.push_back(lsp::ArxmlStorage::normalizeUri(params["rootUri"].get_ref<const std::string&>()));
+    }
+    std::sort(folders.begin(), folders.end());
+    std::string root;
+    for (auto &folder : folders)
+    {
+        root += root.empty() ? folder : "\n" + folder;
+    }
+    return root;
 }
 
 //Callback implementations
 
-void lsp::LanguageService::notification_initialized([[maybe_unused]] const jsonrpcpp::Parameter &params)
+void lsp::LanguageService::notification_initialized([[maybe_unused]] const json &params)
 {
-    toClient_request_workspace_workspaceFolders();
+    //Configuration first, so the settings for indexing are known when the folders get parsed
     toClient_request_workspace_configuration();
+    toClient_request_workspace_workspaceFolders();
 }
 
-void lsp::LanguageService::notification_exit([[maybe_unused]] const jsonrpcpp::Parameter &params)
+void lsp::LanguageService::notification_exit([[maybe_unused]] const json &params)
 {
-    lsp::config::shutdown = true;
+    shutdown_ = true;
     //exit
 }
 
-void lsp::LanguageService::notification_workspace_didChangeConfiguration([[maybe_unused]] const jsonrpcpp::Parameter &params)
+void lsp::LanguageService::notification_workspace_didChangeConfiguration([[maybe_unused]] const json &params)
 {
     lsp::LanguageService::toClient_request_workspace_configuration();
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_initialize(const jsonrpcpp::Id &id, [[maybe_unused]] const jsonrpcpp::Parameter &params)
+//Edited files are parsed again, the open document is the source of truth until it is closed.
+//Files whose content matches what is indexed, e.g. when opening a file or saving changes that were already indexed, are skipped.
+//A shared index is only indexed from disk, unsaved content belongs to the client that edits it
+void lsp::LanguageService::notification_textDocument_didOpen(const json &params)
+{
+    const json &textDocument = params.at("textDocument");
+    if (exclusiveIndex_)
+    {
+        updateDocument(textDocument.at("uri").get<lsp::types::DocumentUri>(), textDocument.at("text").get<std::string>());
+    }
+    else
+    {
+        getIndex()->prioritizeFile(textDocument.at("uri").get<lsp::types::DocumentUri>());
+    }
+}
+
+void lsp::LanguageService::notification_textDocument_didChange(const json &params)
+{
+    const json &contentChanges = params.at("contentChanges");
+    if (exclusiveIndex_ && !contentChanges.empty())
+    {
+        //Full sync, the last change contains the whole text
+        updateDocument(params.at("textDocument").at("uri").get<lsp::types::DocumentUri>(), contentChanges.back().at("text").get<std::string>());
+    }
+}
+
+void lsp::LanguageService::notification_textDocument_didSave(const json &params)
+{
+    lsp::types::DidSaveTextDocumentParams p = params.get<lsp::types::DidSaveTextDocumentParams>();
+    updateDocument(p.textDocument.uri, std::nullopt);
+}
+
+void lsp::LanguageService::notification_textDocument_didClose(const json &params)
+{
+    //Unsaved changes are discarded, so the file on disk is indexed again. A shared index never saw them
+    if (exclusiveIndex_)
+    {
+        lsp::types::DidCloseTextDocumentParams p = params.get<lsp::types::DidCloseTextDocumentParams>();
+        updateDocument(p.textDocument.uri, std::nullopt);
+    }
+}
+
+void lsp::LanguageService::updateDocument(const lsp::types::DocumentUri &uri, std::optional<std::string> content)
+{
+    std::unique_lock<std::mutex> lock(documentUpdatesMutex_);
+    auto [update, isNew] = documentUpdates_.try_emplace(uri);
+    update->second.waiting = true;
+    update->second.content = std::move(content);
+    lock.unlock();
+    //Otherwise the task that is already running for the document picks the update up when it is done
+    if (isNew)
+    {
+        requestExecutor_->submit([this, uri]() { indexDocumentUpdates(uri); });
+    }
+}
+
+void lsp::LanguageService::indexDocumentUpdates(const lsp::types::DocumentUri &uri)
 {
+    while (true)
+    {
+        std::optional<std::string> content;
+        {
+            std::lock_guard<std::mutex> lock(documentUpdatesMutex_);
+            auto update = documentUpdates_.find(uri);
+            if (!update->second.waiting)
+            {
+                documentUpdates_.erase(update);
+                return;
+            }
+            update->second.waiting = false;
+            content = std::move(update->second.content);
+        }
+        try
+        {
+            if (content)
+            {
+                getIndex()->reindexFile(uri, *content);
+            }
+            else
+            {
+                getIndex()->reindexFile(uri);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Could not index " << uri << ": " << e.what() << "\n\n";
+        }
+    }
+}
+
+void lsp::LanguageService::notification_cancelRequest(const json &params)
+{
+    //Requests answered on the main loop are done by the time this arrives
+    messageParser_->cancel_request(jsonrpcpp::Id(params.at("id")));
+}
+
+jsonrpcpp::response_ptr lsp::LanguageService::request_initialize(const jsonrpcpp::Id &id, const json &params)
+{
+    //Every request from here on is answered from the index of the workspace, which other clients might already have open
+    if (!std::atomic_load(&xmlParser_))
+    {
+        std::atomic_store(&xmlParser_, indexRegistry_->acquire(helper_getWorkspaceRoot(params)));
+    }
     json result = {
         {"capabilities", {
             {"referencesProvider", true},
             {"definitionProvider", true},
             {"hoverProvider", true},
+            {"textDocumentSync", {
+                {"openClose", true},
+                //Full
+                {"change", 1},
+                {"save", {
+                    {"includeText", false}
+                }}
+            }},
             {"workspace", {
                 {"workspacefolders", {
                     {"supported", true},
@@ -104,20 +292,23 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_initialize(const jsonrpcpp
     return std::make_shared<jsonrpcpp::Response>(id, result);
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_shutdown(const jsonrpcpp::Id &id, [[maybe_unused]] const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_shutdown(const jsonrpcpp::Id &id, [[maybe_unused]] const json &params)
 {
+    //The responses of all requests received before go out before the response to the shutdown
+    requestExecutor_->waitUntilIdle();
     json result = nullptr;
     return std::make_shared<jsonrpcpp::Response>(id, result);
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_references(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_references(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token)
 {
-    lsp::types::ReferenceParams p = params.to_json().get<lsp::types::ReferenceParams>();
+    lsp::types::ReferenceParams p = params.get<lsp::types::ReferenceParams>();
     json result;
     try
     {
-        std::vector<lsp::types::Location> resVec = xmlParser_->getReferences(p);
-        result = resVec;
+        std::vector<lsp::types::Location> resVec = getIndex()->getReferences(p, referenceLinkToParentShortname_, token);
+        //Written into the message directly, a json tree of thousands of locations takes longer to build than finding them
+        return lsp::SerializedResponse::fromArray(id, resVec, token);
     }
     catch (lsp::elementNotFoundException &e)
     {
@@ -135,13 +326,13 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_references(co
     return std::make_shared<jsonrpcpp::Response>(id, result);
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_definition(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_definition(const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
 {
-    lsp::types::TextDocumentPositionParams p = params.to_json().get<lsp::types::TextDocumentPositionParams>();
+    lsp::types::TextDocumentPositionParams p = params.get<lsp::types::TextDocumentPositionParams>();
     json result;
     try
     {
-        lsp::types::LocationLink link = xmlParser_->getDefinition(p);
+        lsp::types::LocationLink link = getIndex()->getDefinition(p);
         result = link;
     }
     catch (lsp::elementNotFoundException &e)
@@ -161,13 +352,13 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_definition(co
     return std::make_shared<jsonrpcpp::Response>(id, result);
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_hover(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_hover(const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
 {
-    lsp::types::TextDocumentPositionParams p = params.to_json().get<lsp::types::TextDocumentPositionParams>();
+    lsp::types::TextDocumentPositionParams p = params.get<lsp::types::TextDocumentPositionParams>();
     json result;
     try
     {
-        result = xmlParser_->getHover(p);
+        result = getIndex()->getHover(p);
         return std::make_shared<jsonrpcpp::Response>(id, result);     
     }
     catch(lsp::elementNotFoundException &e)
@@ -186,23 +377,22 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_hover(const j
     return std::make_shared<jsonrpcpp::Response>(id, result);
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getChildren(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getChildren(const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token)
 {
     lsp::types::non_standard::GetChildrenParams p;
     try {
-        if((params.to_json().contains("uri")))
+        if((params.contains("uri")))
         {
-            if((params.to_json().contains("path")))
-                p = params.to_json().get<lsp::types::non_standard::GetChildrenParams>();
+            if((params.contains("path")))
+                p = params.get<lsp::types::non_standard::GetChildrenParams>();
             else
             {
-                p.uri = (params.to_json())["uri"];
+                p.uri = params.at("uri");
                 p.path = "";
-                p.unique = (params.to_json())["unique"].get<bool>();
+                p.unique = params.at("unique").get<bool>();
             }
-            std::vector<lsp::types::non_standard::ShortnameTreeElement> resShortnames = xmlParser_->getChildren(p);
-            json result = resShortnames;
-            return std::make_shared<jsonrpcpp::Response>(id, result);
+            std::vector<lsp::types::non_standard::ShortnameTreeElement> resShortnames = getIndex()->getChildren(p, token);
+            return lsp::SerializedResponse::fromArray(id, resShortnames, token);
         }
         else
         {
@@ -223,12 +413,12 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getChildren(const
 
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_owner(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_owner(const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
 {
-    lsp::types::non_standard::OwnerParams p = params.to_json();
+    lsp::types::non_standard::OwnerParams p = params;
     try
     {
-        lsp::types::Location ret = xmlParser_->getOwner(p);
+        lsp::types::Location ret = getIndex()->getOwner(p);
         json result = ret;
         return std::make_shared<jsonrpcpp::Response>(id, result);
     }
@@ -248,24 +438,56 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_textDocument_owner(const j
 void lsp::LanguageService::toClient_request_workspace_configuration()
 {
     json paramsjson = lsp::types::ConfigurationParams{std::vector<lsp::types::ConfigurationItem>{{"arxmlNavigationHelper"}}};
-    jsonrpcpp::Id id(getNextRequestID());
+    jsonrpcpp::Id id(getRequestID());
     jsonrpcpp::Request request(id, "workspace/configuration", paramsjson);
     ioHandler_->addMessageToSend(request.to_json().dump());
-    messageParser_->register_response_callback(id.int_id(), response_workspace_configuration);
+    messageParser_->register_response_callback(id.int_id(), std::bind(&LanguageService::response_workspace_configuration, this, std::placeholders::_1));
 }
 
 void lsp::LanguageService::response_workspace_configuration(const json &results)
 {
-    lsp::config::referenceLinkToParentShortname = results[0]["referenceLinkToParentShortname"].get<bool>();
+    referenceLinkToParentShortname_ = results[0]["referenceLinkToParentShortname"].get<bool>();
+    if (!exclusiveIndex_)
+    {
+        //The index is shared with other clients, it keeps the settings of the daemon
+        return;
+    }
+    //Jobs that are indexing already keep the settings they started with
+    lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    if (results[0].contains("indexingThreads"))
+    {
+        settings.indexingThreads = results[0]["indexingThreads"].get<uint32_t>();
+    }
+    if (results[0].contains("chunkedParsingMinFileSize"))
+    {
+        settings.chunkedParsingMinFileSize = results[0]["chunkedParsingMinFileSize"].get<uint64_t>();
+    }
+    if (results[0].contains("useIndexCache"))
+    {
+        settings.useIndexCache = results[0]["useIndexCache"].get<bool>();
+    }
+    if (results[0].contains("indexCacheDirectory"))
+    {
+        settings.indexCacheDirectory = results[0]["indexCacheDirectory"].get<std::string>();
+    }
+    if (results[0].contains("watchWorkspaceFolders"))
+    {
+        settings.watchWorkspaceFolders = results[0]["watchWorkspaceFolders"].get<bool>();
+    }
+    if (results[0].contains("fileWatcherDebounceTime"))
+    {
+        settings.fileWatcherDebounceTime = results[0]["fileWatcherDebounceTime"].get<uint32_t>();
+    }
+    lsp::config::setIndexSettings(settings);
 }
 
 void lsp::LanguageService::toClient_request_workspace_workspaceFolders()
 {
     json paramsjson = nullptr;
-    jsonrpcpp::Id id(getNextRequestID());
+    jsonrpcpp::Id id(getRequestID());
     jsonrpcpp::Request request(id, "workspace/workspaceFolders", paramsjson);
     ioHandler_->addMessageToSend(request.to_json().dump());
-    messageParser_->register_response_callback(id.int_id(), response_workspace_workspaceFolders);
+    messageParser_->register_response_callback(id.int_id(), std::bind(&LanguageService::response_workspace_workspaceFolders, this, std::placeholders::_1));
 }
 
 void lsp::LanguageService::response_workspace_workspaceFolders(const json &results)
@@ -273,16 +495,27 @@ void lsp::LanguageService::response_workspace_workspaceFolders(const json &resul
 #ifndef NO_TERMINAL_OUTPUT
     std::cout << "WorkspaceFolders received:\n" << results.dump(2) << "\n\n";
 #endif
+    std::vector<lsp::types::DocumentUri> folderUris;
     if (results != nullptr)
     {
         for (auto result : results)
         {
-            lsp::types::DocumentUri fileUri = result["uri"].get<std::string>();
-            xmlParser_->parseFullFolder(fileUri);
+            folderUris.push_back(result["uri"].get<std::string>());
         }
     }
-    json params = {{"event", "treeViewReady"}};
-    toClient_notification_telemetry_event(params);
+    //Indexed in the background, requests are answered from the files indexed so far until the tree view is ready.
+    //If another client has the workspace open, it is only indexed once and this client is told when it is ready.
+    //The index can outlive the connection, so the callback doesn't use anything but the IOHandler, and only while it exists
+    std::weak_ptr<lsp::IOHandler> ioHandler = ioHandler_;
+    getIndex()->parseFoldersInBackground(folderUris, [ioHandler]()
+    {
+        if (auto handler = ioHandler.lock())
+        {
+            jsonrpcpp::Notification notification("telemetry/event", json{{"event", "treeViewReady"}});
+            handler->addMessageToSend(notification.to_json().dump());
+            handler->writeAllMessages();
+        }
+    });
     toClient_request_client_registerCapability("workspace/didChangeConfiguration");
 }
 
@@ -311,19 +544,18 @@ void lsp::LanguageService::toClient_request_client_registerCapability(const std:
             }
         }}
     };
-    jsonrpcpp::Id id(getNextRequestID());
+    jsonrpcpp::Id id(getRequestID());
     jsonrpcpp::Request request(id, "client/registerCapability", paramsjson);
     ioHandler_->addMessageToSend(request.to_json().dump());
-    messageParser_->register_response_callback(id.int_id(), response_void);
+    messageParser_->register_response_callback(id.int_id(), std::bind(&LanguageService::response_void, this, std::placeholders::_1));
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getParentElement(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getParentElement(const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
 {
     try{
-        json paramsjson = params.to_json();
-        std::string path = paramsjson["path"].get<std::string>();
-        std::string uri = paramsjson["uri"].get<std::string>();
-        lsp::types::non_standard::ShortnameTreeElement elem = xmlParser_->getParent(path, uri);
+        std::string path = params.at("path").get<std::string>();
+        std::string uri = params.at("uri").get<std::string>();
+        lsp::types::non_standard::ShortnameTreeElement elem = getIndex()->getParent(path, uri);
         json result = nullptr;
         if(!elem.name.compare(""))
         {
@@ -344,15 +576,14 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getParentElement(
     }
 }
 
-jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getNearestShortname(const jsonrpcpp::Id &id, const jsonrpcpp::Parameter &params)
+jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getNearestShortname(const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
 {
     try
     {
-        json paramsjson = params.to_json();
         lsp::types::TextDocumentPositionParams lspParams;
-        lspParams.position = paramsjson["position"].get<lsp::types::Position>();
-        lspParams.textDocument.uri =paramsjson["uri"].get<std::string>();
-        json result = xmlParser_->getNearestShortname(lspParams);
+        lspParams.position = params.at("position").get<lsp::types::Position>();
+        lspParams.textDocument.uri = params.at("uri").get<std::string>();
+        json result = getIndex()->getNearestShortname(lspParams);
         return std::make_shared<jsonrpcpp::Response>(id, result);
     }
     catch(lsp::badUriException &e)
@@ -368,6 +599,18 @@ jsonrpcpp::response_ptr lsp::LanguageService::request_treeView_getNearestShortna
 
 }
 
+jsonrpcpp::response_ptr lsp::LanguageService::request_workspace_getWatcherStatistics(const jsonrpcpp::Id &id, [[maybe_unused]] const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
+{
+    json result = getIndex()->getWatcherStatistics();
+    return std::make_shared<jsonrpcpp::Response>(id, result);
+}
+
+jsonrpcpp::response_ptr lsp::LanguageService::request_workspace_getCancellationStatistics(const jsonrpcpp::Id &id, [[maybe_unused]] const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
+{
+    json result = messageParser_->get_cancellation_statistics();
+    return std::make_shared<jsonrpcpp::Response>(id, result);
+}
+
 void lsp::LanguageService::response_void([[maybe_unused]] const json &results)
 {
 }
\ No newline at end of file
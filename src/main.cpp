@@ -1,27 +1,111 @@
 #include <iostream>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cctype>
 
 #include "boost/asio.hpp"
 
 #include "languageService.hpp"
+#include "transport.hpp"
+#include "daemon.hpp"
 
 using namespace boost;
 
+//Ports are given as decimal numbers, returns false for anything else or a number outside of 1-65535
+bool helper_parsePort(const std::string &text, uint32_t &port)
+{
+    if (text.empty() || !std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); }))
+    {
+        return false;
+    }
+    try
+    {
+        const unsigned long value = std::stoul(text);
+        if (value == 0 || value > 65535)
+        {
+            return false;
+        }
+        port = static_cast<uint32_t>(value);
+        return true;
+    }
+    catch (const std::out_of_range &e)
+    {
+        return false;
+    }
+}
+
+void helper_printUsage()
+{
+    std::cout << "Usage: ARXML_LanguageServer [port | --stdio | --listen <port or Unix socket path>]\n";
+}
+
 int main(int argc, char** argv)
 {
+    //Clients that start the server as a child process and talk to it over its stdin/stdout pass --stdio
+    if (argc > 1 && std::string(argv[1]) == "--stdio")
+    {
+        lsp::LanguageService::start(std::make_unique<lsp::StdioTransport>());
+        return 0;
+    }
+
+    //Daemon mode: clients connect to a port or a Unix socket, and clients with the same workspace share its index
+    if (argc > 1 && std::string(argv[1]) == "--listen")
+    {
+        if (argc < 3 || std::string(argv[2]).empty())
+        {
+            std::cout << "--listen needs a port or the path of a Unix socket\n";
+            helper_printUsage();
+            return 1;
+        }
+        const std::string where = argv[2];
+        if (std::all_of(where.begin(), where.end(), [](unsigned char c) { return std::isdigit(c); }))
+        {
+            uint32_t port;
+            if (!helper_parsePort(where, port))
+            {
+                std::cout << "Invalid port: " << where << "\n";
+                helper_printUsage();
+                return 1;
+            }
+            lsp::Daemon daemon(port);
+            daemon.run();
+        }
+        else
+        {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+            lsp::Daemon daemon(where);
+            daemon.run();
+#else
+            std::cout << "Unix sockets are not supported on this system, listen on a port instead\n";
+            return 1;
+#endif
+        }
+        return 0;
+    }
+
     uint32_t portNr;
     //Get the port from the command line
     if( argc == 1 )
     {
         //No port specified
         std::cout << "Specify port to connect to: ";
-        std::cin >> portNr;
+        std::string input;
+        std::cin >> input;
+        if (!helper_parsePort(input, portNr))
+        {
+            std::cout << "Invalid port: " << input << "\n";
+            return 1;
+        }
     }
-    else if (argc > 1)
+    else if (!helper_parsePort(argv[1], portNr))
     {
-        portNr = std::stoi(argv[1]);
+        std::cout << "Invalid port: " << argv[1] << "\n";
+        helper_printUsage();
+        return 1;
     }
 
-    lsp::LanguageService::start("127.0.0.1", portNr);
+    lsp::LanguageService::start(std::make_unique<lsp::TcpTransport>("127.0.0.1", portNr));
     
     return 0;
-}
\ No newline at end of file
+}
@@ -7,69 +7,159 @@ void lsp::MessageParser::register_response_callback(const uint32_t id, response_
         response_callbacks_[id] = callback;
 }
 
-void lsp::MessageParser::register_notification_callback(const std::string &notification, jsonrpcpp::notification_callback callback)
+void lsp::MessageParser::register_notification_callback(const std::string &notification, notification_callback callback)
 {
     if(callback)
-        notification_callbacks_[notification] = callback;
+        method_callbacks_[notification].notification = callback;
 }
 
-void lsp::MessageParser::register_request_callback(const std::string &request, jsonrpcpp::request_callback callback)
+void lsp::MessageParser::register_request_callback(const std::string &request, request_callback callback)
 {
     if(callback)
-        request_callbacks_[request] = callback;
+        method_callbacks_[request].request = callback;
+}
+
+void lsp::MessageParser::register_concurrent_request_callback(const std::string &request, cancellable_request_callback callback)
+{
+    if(callback)
+        method_callbacks_[request].concurrentRequest = callback;
+}
+
+void lsp::MessageParser::set_request_executor(std::shared_ptr<RequestExecutor> executor, response_handler handler)
+{
+    executor_ = executor;
+    response_handler_ = handler;
+}
+
+void lsp::MessageParser::cancel_request(const jsonrpcpp::Id &id)
+{
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    cancellation_statistics_.cancelRequests++;
+    auto pending = pending_requests_.find(id.to_json().dump());
+    if (pending == pending_requests_.end())
+    {
+        cancellation_statistics_.tooLate++;
+        return;
+    }
+    pending->second.cancel();
+}
+
+lsp::types::non_standard::CancellationStatistics lsp::MessageParser::get_cancellation_statistics()
+{
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    return cancellation_statistics_;
 }
 
 jsonrpcpp::entity_ptr lsp::MessageParser::parse(const std::string &json_str)
 {
-    jsonrpcpp::entity_ptr entity = do_parse(json_str);
-    if (entity && entity->is_notification())
+    //Parsed once, the callbacks read their parameters from this document
+    json document = json::parse(json_str, nullptr, false);
+    if (!document.is_object())
     {
-        jsonrpcpp::notification_ptr notification = std::dynamic_pointer_cast<jsonrpcpp::Notification>(entity);
-        if (notification_callbacks_.find(notification->method()) != notification_callbacks_.end())
+        throw lsp::badEntityException();
+    }
+    auto method = document.find("method");
+    auto id = document.find("id");
+    auto params = document.find("params");
+    json noParams;
+    json &messageParams = params != document.end() ? *params : noParams;
+
+    if (method != document.end() && method->is_string())
+    {
+        auto callbacks = method_callbacks_.find(method->get_ref<const std::string&>());
+        if (id == document.end())
         {
-            jsonrpcpp::notification_callback callback = notification_callbacks_[notification->method()];
-            if (callback)
+            //Notifications nobody registered for, like $/setTrace, are ignored
+            if (callbacks != method_callbacks_.end() && callbacks->second.notification)
             {
-                callback(notification->params());
+                callbacks->second.notification(messageParams);
             }
             return nullptr;
         }
-    }
-    else if (entity && entity->is_request())
-    {
-        jsonrpcpp::request_ptr request = std::dynamic_pointer_cast<jsonrpcpp::Request>(entity);
-        if (request_callbacks_.find(request->method()) != request_callbacks_.end())
+
+        jsonrpcpp::Id requestId(*id);
+        if (callbacks == method_callbacks_.end() || !(callbacks->second.request || callbacks->second.concurrentRequest))
+        {
+            return std::make_shared<jsonrpcpp::Response>(requestId, jsonrpcpp::Error("MethodNotFound", -32601));
+        }
+        if (callbacks->second.concurrentRequest)
         {
-            jsonrpcpp::request_callback callback = request_callbacks_[request->method()];
-            if (callback)
+            cancellable_request_callback callback = callbacks->second.concurrentRequest;
+            if (!executor_)
             {
-                jsonrpcpp::response_ptr response = callback(request->id(), request->params());
-                if (response)
-                    return response;
+                return callback(requestId, messageParams, CancellationToken());
             }
-            else
+            //Moved out of the document, the request outlives it
+            auto requestParams = std::make_shared<const json>(std::move(messageParams));
+            const std::string idKey = requestId.to_json().dump();
+            const CancellationToken token = CancellationToken::create();
             {
-                jsonrpcpp::Error err("MethodNotFound", -32601);
-                jsonrpcpp::Response(request->id(), err);
+                std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+                pending_requests_[idKey] = token;
             }
-            
+            response_handler handler = response_handler_;
+            executor_->submit([this, requestId, requestParams, callback, handler, idKey, token]()
+            {
+                jsonrpcpp::response_ptr response;
+                bool skipped = token.isCancelled();
+                bool stopped = false;
+                auto t0 = std::chrono::steady_clock::now();
+                if (!skipped)
+                {
+                    try
+                    {
+                        response = callback(requestId, *requestParams, token);
+                        //Cancelled after the result was built, sending the cancel error instead still saves serializing and writing the result
+                        stopped = token.isCancelled();
+                    }
+                    catch (const lsp::requestCancelledException &e)
+                    {
+                        stopped = true;
+                    }
+                    catch (const std::exception &e)
+                    {
+                        //The client waits for a response to every request
+                        response = std::make_shared<jsonrpcpp::Response>(requestId, jsonrpcpp::Error(e.what(), -32603));
+                    }
+                }
+                if (skipped || stopped)
+                {
+                    response = std::make_shared<jsonrpcpp::Response>(requestId, jsonrpcpp::Error("RequestCancelled", -32800));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+                    pending_requests_.erase(idKey);
+                    cancellation_statistics_.skipped += skipped;
+                    cancellation_statistics_.stopped += stopped;
+                    if (stopped)
+                    {
+                        cancellation_statistics_.stoppedRunTime +=
+                            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+                    }
+                }
+                if (response)
+                {
+                    handler(response);
+                }
+            });
+            return nullptr;
         }
+        return callbacks->second.request(requestId, messageParams);
     }
-    else if (entity && entity->is_response())
+    else if (id != document.end() && id->is_number_unsigned())
     {
-        jsonrpcpp::response_ptr response = std::dynamic_pointer_cast<jsonrpcpp::Response>(entity);
-        if (response_callbacks_.find(response->id().int_id()) != response_callbacks_.end())
+        auto callback = response_callbacks_.find(id->get<uint32_t>());
+        if (callback != response_callbacks_.end())
         {
-            response_callback callback = response_callbacks_[response->id().int_id()];
-            if (callback)
-            {
-                //Remove the callback for this id
-                response_callbacks_.erase(response->id().int_id());
-                callback(response->result());
-                return nullptr;
-            }
+            //Remove the callback for this id
+            response_callback responseCallback = std::move(callback->second);
+            response_callbacks_.erase(callback);
+            //Error responses have no result
+            auto result = document.find("result");
+            responseCallback(result != document.end() ? *result : json(nullptr));
+            return nullptr;
         }
     }
     throw lsp::badEntityException();
     return nullptr;
-}
\ No newline at end of file
+}
@@ -0,0 +1,80 @@
+#include "requestExecutor.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <exception>
+
+lsp::RequestExecutor::RequestExecutor(uint32_t numThreads)
+    : tasks_(), pendingTasks_(0), stop_(false)
+{
+    if (!numThreads)
+    {
+        //A single worker would make a fast request wait for a slow one again
+        numThreads = std::max(std::thread::hardware_concurrency(), 2u);
+    }
+    for (uint32_t i = 0; i < numThreads; i++)
+    {
+        workers_.emplace_back(&RequestExecutor::run, this);
+    }
+}
+
+lsp::RequestExecutor::~RequestExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    taskAvailable_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void lsp::RequestExecutor::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        pendingTasks_++;
+    }
+    taskAvailable_.notify_one();
+}
+
+void lsp::RequestExecutor::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !pendingTasks_; });
+}
+
+void lsp::RequestExecutor::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskAvailable_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            //Queued tasks are still run when stopping, every request gets its response
+            if (tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        try
+        {
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Request failed: " << e.what() << "\n\n";
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!--pendingTasks_)
+        {
+            idle_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "structuralScanner.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STRUCTURALSCANNER_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+void helper_classifyScalar(const char *block, lsp::StructuralMasks &masks)
+{
+    masks = lsp::StructuralMasks{0, 0, 0, 0, 0};
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        const uint64_t bit = 1ULL << i;
+        switch (block[i])
+        {
+            case '<': masks.tagOpen |= bit; break;
+            case '>': masks.tagClose |= bit; break;
+            case '/': masks.slash |= bit; break;
+            case '"': masks.quote |= bit; break;
+            case '\n': masks.newline |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef STRUCTURALSCANNER_X86
+
+__attribute__((target("sse2")))
+inline uint64_t helper_maskSSE2(const __m128i (&chunks)[4], char character)
+{
+    const __m128i pattern = _mm_set1_epi8(character);
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        result |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], pattern)))) << (16 * i);
+    }
+    return result;
+}
+
+__attribute__((target("sse2")))
+void helper_classifySSE2(const char *block, lsp::StructuralMasks &masks)
+{
+    __m128i chunks[4];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+    }
+    masks.tagOpen = helper_maskSSE2(chunks, '<');
+    masks.tagClose = helper_maskSSE2(chunks, '>');
+    masks.slash = helper_maskSSE2(chunks, '/');
+    masks.quote = helper_maskSSE2(chunks, '"');
+    masks.newline = helper_maskSSE2(chunks, '\n');
+}
+
+__attribute__((target("avx2")))
+inline uint64_t helper_maskAVX2(const __m256i &low, const __m256i &high, char character)
+{
+    const __m256i pattern = _mm256_set1_epi8(character);
+    const uint64_t lowBits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+    const uint64_t highBits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+    return lowBits | (highBits << 32);
+}
+
+__attribute__((target("avx2")))
+void helper_classifyAVX2(const char *block, lsp::StructuralMasks &masks)
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    masks.tagOpen = helper_maskAVX2(low, high, '<');
+    masks.tagClose = helper_maskAVX2(low, high, '>');
+    masks.slash = helper_maskAVX2(low, high, '/');
+    masks.quote = helper_maskAVX2(low, high, '"');
+    masks.newline = helper_maskAVX2(low, high, '\n');
+}
+
+#endif
+
+lsp::classifyBlock_t helper_selectKernel(const char **name)
+{
+#ifdef STRUCTURALSCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "AVX2";
+        return helper_classifyAVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        *name = "SSE2";
+        return helper_classifySSE2;
+    }
+#endif
+    *name = "scalar";
+    return helper_classifyScalar;
+}
+
+static const char *kernelName = nullptr;
+const lsp::classifyBlock_t lsp::StructuralScanner::kernel_ = helper_selectKernel(&kernelName);
+
+const char *lsp::StructuralScanner::getKernelName()
+{
+    return kernelName;
+}
+
+lsp::StructuralScanner::StructuralScanner(const char *start, const char *rangeBegin, const char *rangeEnd, const char *end, std::vector<uint32_t> &newlineOffsets)
+    : start_(start), rangeEnd_(rangeEnd), end_(end), newlineOffsets_(newlineOffsets), block_(rangeBegin)
+{
+    classify();
+}
+
+void lsp::StructuralScanner::finish()
+{
+    while (block_ + 64 < rangeEnd_)
+        nextBlock();
+}
+
+void lsp::StructuralScanner::nextBlock()
+{
+    block_ += 64;
+    classify();
+}
+
+void lsp::StructuralScanner::classify()
+{
+    if (block_ + 64 <= end_)
+    {
+        kernel_(block_, masks_);
+    }
+    else
+    {
+        //Don't read past the end of the file, the padding can't match any structural character
+        char padded[64] = {0};
+        memcpy(padded, block_, end_ - block_);
+        kernel_(padded, masks_);
+    }
+
+    if (block_ < rangeEnd_)
+    {
+        uint64_t newlines = masks_.newline;
+        if (rangeEnd_ - block_ < 64)
+            newlines &= (1ULL << (rangeEnd_ - block_)) - 1;
+        const uint32_t blockOffset = block_ - start_;
+        while (newlines)
+        {
+            newlineOffsets_.push_back(blockOffset + countTrailingZeros(newlines));
+            newlines &= newlines - 1;
+        }
+    }
+}
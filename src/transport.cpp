@@ -0,0 +1,217 @@
+#include "transport.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include "boost/asio.hpp"
+
+#include "lspExceptions.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <sys/uio.h>
+#endif
+
+using namespace boost;
+
+#ifdef F_SETPIPE_SZ
+//Pipes are asked for this much room, so a large response or an opened document needs fewer reads and writes than with the default of 64kb
+static const int pipeSize = 1024 * 1024;
+#endif
+
+//Both socket transports read and write the same way
+template <typename Socket>
+std::size_t helper_readSome(Socket &socket, char *data, std::size_t size)
+{
+    boost::system::error_code ec;
+    size_t received = socket.read_some(asio::buffer(data, size), ec);
+    if (ec)
+    {
+        std::cerr << ec.message() << std::endl;
+        throw lsp::connectionClosedException();
+    }
+    return received;
+}
+
+template <typename Socket>
+void helper_write(Socket &socket, const std::vector<asio::const_buffer> &buffers)
+{
+    //asio passes the buffers to writev in batches the system accepts
+    asio::write(socket, buffers);
+}
+
+lsp::TcpTransport::TcpTransport(const std::string &address, uint32_t port)
+    : ioc_(), socket_(ioc_)
+{
+    asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(address), port);
+    std::cout << "Connecting to " << address << ":" << port << "...\n";
+    socket_.connect(endpoint);
+    //Responses are written as soon as they are ready, waiting to coalesce them only delays the next one
+    socket_.set_option(asio::ip::tcp::no_delay(true));
+    std::cout << "Connection established\n";
+}
+
+lsp::TcpTransport::TcpTransport(asio::ip::tcp::socket socket)
+    : ioc_(), socket_(std::move(socket))
+{
+    socket_.set_option(asio::ip::tcp::no_delay(true));
+}
+
+std::size_t lsp::TcpTransport::readSome(char *data, std::size_t size)
+{
+    return helper_readSome(socket_, data, size);
+}
+
+void lsp::TcpTransport::write(const std::vector<asio::const_buffer> &buffers)
+{
+    helper_write(socket_, buffers);
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+lsp::UnixSocketTransport::UnixSocketTransport(asio::local::stream_protocol::socket socket)
+    : socket_(std::move(socket))
+{
+}
+
+std::size_t lsp::UnixSocketTransport::readSome(char *data, std::size_t size)
+{
+    return helper_readSome(socket_, data, size);
+}
+
+void lsp::UnixSocketTransport::write(const std::vector<asio::const_buffer> &buffers)
+{
+    helper_write(socket_, buffers);
+}
+#endif
+
+lsp::StdioTransport::StdioTransport()
+{
+    std::fflush(stdout);
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    inFd_ = _fileno(stdin);
+    outFd_ = _dup(_fileno(stdout));
+    _setmode(outFd_, _O_BINARY);
+    _dup2(_fileno(stderr), _fileno(stdout));
+#else
+    inFd_ = STDIN_FILENO;
+    //Keep the protocol stream on a descriptor of its own and point descriptor 1 to stderr,
+    //so nothing written to std::cout or stdout can end up between two messages
+    outFd_ = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+    if (outFd_ < 0)
+    {
+        throw boost::system::system_error(errno, boost::system::system_category(), "Could not take over stdout");
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    //A client that is gone is reported by write(), instead of killing the server
+    std::signal(SIGPIPE, SIG_IGN);
+#ifdef F_SETPIPE_SZ
+    //Only works for pipes, a terminal or a file keeps its size
+    fcntl(inFd_, F_SETPIPE_SZ, pipeSize);
+    fcntl(outFd_, F_SETPIPE_SZ, pipeSize);
+#endif
+#endif
+    //stdout was a pipe, which buffers everything until exit, diagnostics should show up when they are written
+    std::setvbuf(stdout, nullptr, _IOLBF, BUFSIZ);
+    std::cout << "Communicating over stdin/stdout\n";
+}
+
+lsp::StdioTransport::~StdioTransport()
+{
+    std::fflush(stdout);
+#ifdef _WIN32
+    _dup2(outFd_, _fileno(stdout));
+    _close(outFd_);
+#else
+    dup2(outFd_, STDOUT_FILENO);
+    close(outFd_);
+#endif
+}
+
+std::size_t lsp::StdioTransport::readSome(char *data, std::size_t size)
+{
+    while (true)
+    {
+#ifdef _WIN32
+        int received = _read(inFd_, data, static_cast<unsigned int>(std::min<std::size_t>(size, INT_MAX)));
+#else
+        ssize_t received = read(inFd_, data, size);
+#endif
+        if (received > 0)
+        {
+            return received;
+        }
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received < 0)
+        {
+            std::cerr << "Could not read from stdin: " << std::strerror(errno) << std::endl;
+        }
+        throw lsp::connectionClosedException();
+    }
+}
+
+void lsp::StdioTransport::write(const std::vector<asio::const_buffer> &buffers)
+{
+#ifdef _WIN32
+    for (auto &buffer : buffers)
+    {
+        const char *data = static_cast<const char*>(buffer.data());
+        std::size_t remaining = buffer.size();
+        while (remaining)
+        {
+            int written = _write(outFd_, data, static_cast<unsigned int>(std::min<std::size_t>(remaining, INT_MAX)));
+            if (written < 0)
+            {
+                throw boost::system::system_error(errno, boost::system::system_category(), "Could not write to stdout");
+            }
+            data += written;
+            remaining -= written;
+        }
+    }
+#else
+    std::vector<iovec> iov;
+    iov.reserve(buffers.size());
+    for (auto &buffer : buffers)
+    {
+        if (buffer.size())
+        {
+            iov.push_back({const_cast<void*>(buffer.data()), buffer.size()});
+        }
+    }
+    //Gather write like the TCP transport, in batches of IOV_MAX buffers, continuing where a partial write stopped
+    for (std::size_t first = 0; first < iov.size(); )
+    {
+        ssize_t written = writev(outFd_, &iov[first], std::min<std::size_t>(iov.size() - first, IOV_MAX));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw boost::system::system_error(errno, boost::system::system_category(), "Could not write to stdout");
+        }
+        while (first < iov.size() && static_cast<std::size_t>(written) >= iov[first].iov_len)
+        {
+            written -= iov[first].iov_len;
+            first++;
+        }
+        if (written)
+        {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + written;
+            iov[first].iov_len -= written;
+        }
+    }
+#endif
+}
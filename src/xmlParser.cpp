@@ -2,12 +2,28 @@
 
 #include "lspExceptions.hpp"
 #include "config.hpp"
+#include "structuralScanner.hpp"
+#include "indexCache.hpp"
 
 #include "boost/filesystem.hpp"
 
 #include <chrono>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <set>
+
+//A batch of scanned files is published once it has at least an eighth of the size of the files published before it
+static const uint32_t publishBatchDivisor = 8;
 
 const std::string helper_makeURI(std::string sanitizedFilePath)
 {
@@ -16,16 +32,16 @@ const std::string helper_makeURI(std::string sanitizedFilePath)
     return ret;
 }
 
-const lsp::ShortnameElement &helper_getShortnameFromInnerPath(std::shared_ptr<lsp::ArxmlStorage> storage, lsp::ReferenceElement &reference, const uint32_t offset)
+const lsp::ShortnameElement &helper_getShortnameFromInnerPath(const lsp::ArxmlStorage &storage, const lsp::ReferenceElement &reference, const uint32_t offset)
 {
     uint32_t cursorDistance = offset - reference.charOffset;
-    auto shortnames = (storage->getShortnamesByFullPath(reference.targetPath));
-    if(shortnames.size() != 1)
+    //Resolved in the generation that answers the request
+    if(storage.getTargetCount(reference) != 1)
     {
         throw lsp::multipleDefinitionException();
     }
-    const lsp::ShortnameElement* shortname = shortnames[0];
-    std::string fullPath = shortname->getFullPath();
+    const lsp::ShortnameElement* shortname = storage.getTarget(reference);
+    const std::string &fullPath = shortname->getFullPath();
     uint32_t num = std::count(fullPath.begin() + cursorDistance, fullPath.end(), '/');
     for(uint32_t i = 0; i < num; i++)
     {
@@ -52,12 +68,6 @@ std::vector<std::string> helper_getARXMLFilePathsInDirectory(boost::filesystem::
     return arxmlFilesInDirectory;
 }
 
-uint32_t helper_getNextUsageID()
-{
-    static uint32_t currentID = 0;
-    return currentID++;
-}
-
 const std::string helper_sanitizeUri(std::string unsanitized)
 {
     std::string sanitizedFilePath = unsanitized;
@@ -67,10 +77,211 @@ const std::string helper_sanitizeUri(std::string unsanitized)
     return sanitizedFilePath;
 }
 
+uint32_t helper_getIndexingThreads(const lsp::config::IndexSettings &settings)
+{
+    uint32_t numThreads = settings.indexingThreads ? settings.indexingThreads : std::thread::hardware_concurrency();
+    return std::max<uint32_t>(numThreads, 1);
+}
+
+//Takes up to wanted threads from the idle ones, they are given back by adding them again
+uint32_t helper_borrowThreads(std::atomic<uint32_t> &idleThreads, uint32_t wanted)
+{
+    uint32_t idle = idleThreads.load();
+    uint32_t borrowed;
+    do
+    {
+        borrowed = std::min(idle, wanted);
+    } while (borrowed && !idleThreads.compare_exchange_weak(idle, idle - borrowed));
+    return borrowed;
+}
+
+lsp::IndexCache helper_getIndexCache(const lsp::config::IndexSettings &settings)
+{
+    if (!settings.useIndexCache)
+    {
+        return lsp::IndexCache("");
+    }
+    if (!settings.indexCacheDirectory.empty())
+    {
+        return lsp::IndexCache(settings.indexCacheDirectory);
+    }
+    try
+    {
+        return lsp::IndexCache((boost::filesystem::temp_directory_path() / "ARXML_LanguageServer" / "indexCache").string());
+    }
+    catch (const boost::filesystem::filesystem_error &e)
+    {
+        return lsp::IndexCache("");
+    }
+}
+
+//Checks if the file has a SHORT-NAME with one of the names. Only the SHORT-NAME tags are looked at, which is a lot cheaper than scanning the file
+bool helper_definesShortname(const std::string &filePath, const std::unordered_set<std::string_view> &names)
+{
+    try
+    {
+        if (!boost::filesystem::file_size(filePath))
+        {
+            return false;
+        }
+        boost::iostreams::mapped_file_source mmap(filePath);
+        const std::string_view content(mmap.data(), mmap.size());
+        const std::string_view tag = "<SHORT-NAME>";
+        for (size_t position = content.find(tag); position != std::string_view::npos; position = content.find(tag, position))
+        {
+            position += tag.size();
+            const size_t end = content.find('<', position);
+            if (end == std::string_view::npos)
+            {
+                break;
+            }
+            if (names.count(content.substr(position, end - position)))
+            {
+                return true;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+    }
+    return false;
+}
+
+//Last names of the reference targets of a file, see XmlParser::IndexingJob::targetNames
+std::vector<std::string> helper_getTargetNames(const lsp::StagedFile &file)
+{
+    std::vector<std::string> targetNames;
+    targetNames.reserve(file.references.size());
+    for (auto &reference : file.references)
+    {
+        targetNames.push_back(reference.targetPath.substr(reference.targetPath.find_last_of('/') + 1));
+    }
+    return targetNames;
+}
+
+//Checked every 1024 result elements, often enough to stop within a millisecond and rare enough to cost nothing
+void helper_checkCancelled(const lsp::CancellationToken &token, size_t processed)
+{
+    if (!(processed & 1023))
+    {
+        token.throwIfCancelled();
+    }
+}
+
+//Calls function for every index in [0, count) on numThreads threads and rethrows the first exception thrown by any call
+void helper_parallelFor(size_t count, uint32_t numThreads, const std::function<void(size_t)> &function)
+{
+    std::atomic<size_t> next{0};
+    std::exception_ptr workerException = nullptr;
+    std::mutex exceptionMutex;
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < std::min<size_t>(numThreads, count); i++)
+    {
+        workers.emplace_back([&]()
+        {
+            for (size_t index = next++; index < count; index = next++)
+            {
+                try
+                {
+                    function(index);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(exceptionMutex);
+                    if (!workerException)
+                        workerException = std::current_exception();
+                    next = count;
+                }
+            }
+        });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    if (workerException)
+    {
+        std::rethrow_exception(workerException);
+    }
+}
+
+enum class tagType
+{
+    opening_tag,
+    closing_tag,
+    shortname,
+    reference,
+    undefined_tag,
+};
+
+//Classifies the content of an opening tag between '<' and '>' without copying it.
+//SHORT-NAME is the only tag matched by its name, so its length and first character rule out almost every other tag before comparing.
+//Any tag containing DEST is a reference
+tagType helper_classifyOpeningTag(const std::string_view tagContent)
+{
+    static constexpr std::string_view shortnameTag = "SHORT-NAME";
+    if (tagContent.size() == shortnameTag.size() && tagContent[0] == 'S' && tagContent == shortnameTag)
+        return tagType::shortname;
+    if (tagContent.find("DEST") != std::string_view::npos)
+        return tagType::reference;
+    return tagType::opening_tag;
+}
+
+//Formats the scan throughput and the structural classification kernel used, e.g. "1.23 GB/s, AVX2"
+const std::string helper_formatThroughput(size_t bytes, std::chrono::high_resolution_clock::duration duration)
+{
+    std::ostringstream stream;
+    const double seconds = std::chrono::duration<double>(duration).count();
+    stream.precision(3);
+    stream << (seconds > 0 ? bytes / seconds / 1e9 : 0.0) << " GB/s, " << lsp::StructuralScanner::getKernelName();
+    return stream.str();
+}
+
+//Splits the file into roughly equal chunks, returns the start of every chunk and the end of the file.
+//Chunks only start at opening tags that don't depend on the tags before them: no comments, no closing or self closing tags and no SHORT-NAME,
+//as the IDENT handling looks at the tag before a SHORT-NAME
+std::vector<const char*> helper_getChunkBoundaries(const char *const start, const char *const end, uint32_t numChunks)
+{
+    std::vector<const char*> boundaries{start};
+    const size_t size = end - start;
+    for (uint32_t chunkNr = 1; chunkNr < numChunks; chunkNr++)
+    {
+        const char *current = std::max(start + size / numChunks * chunkNr, boundaries.back() + 1);
+        while (current && current < end)
+        {
+            current = static_cast<const char*>(memchr(current, '<', end - current));
+            if (!current || current + 1 >= end)
+            {
+                current = nullptr;
+                break;
+            }
+            const char *tagEnd = static_cast<const char*>(memchr(current, '>', end - current));
+            if (!tagEnd)
+            {
+                current = nullptr;
+                break;
+            }
+            const char next = *(current + 1);
+            if (next != '/' && next != '!' && next != '?' && *(tagEnd - 1) != '/'
+                && helper_classifyOpeningTag(std::string_view(current + 1, tagEnd - current - 1)) != tagType::shortname)
+            {
+                break;
+            }
+            current = tagEnd;
+        }
+        if (!current || current >= end)
+            break;
+        boundaries.push_back(current);
+    }
+    boundaries.push_back(end);
+    return boundaries;
+}
+
 const lsp::types::Hover lsp::XmlParser::getHover(const lsp::types::TextDocumentPositionParams &params)
 {
-    auto storage = getStorageForUri(params.textDocument.uri);
-    uint32_t fileIndex = storage->getFileIndex(params.textDocument.uri);
+    uint32_t fileIndex;
+    auto storage = getSnapshot(params.textDocument.uri, fileIndex);
     uint32_t offset = storage->getOffsetFromPosition(params.position, fileIndex) + 2;
     ShortnameElement shortname;
     //Is it a shortname?
@@ -82,20 +293,21 @@ const lsp::types::Hover lsp::XmlParser::getHover(const lsp::types::TextDocumentP
     catch (const lsp::elementNotFoundException &e)
     {
         ReferenceElement reference = storage->getReferenceByOffset(offset, fileIndex);
-        shortname = helper_getShortnameFromInnerPath(storage, reference, offset);
+        shortname = helper_getShortnameFromInnerPath(*storage, reference, offset);
     }
     lsp::types::Hover result;
     result.contents += "**Full path:** " + shortname.getFullPath() + "\n";
     for (uint32_t i = 0; i < shortname.references.size() && i < 10; ++i)
     {
-        auto targets = storage->getShortnamesByFullPath(shortname.references[i]->targetPath);
-        if(targets.size() == 1)
+        const lsp::ShortnameElement *target = storage->getTarget(*shortname.references[i]);
+        const uint32_t targetCount = storage->getTargetCount(*shortname.references[i]);
+        if(targetCount == 1)
         {
-            std::string link = storage->getUriFromFileIndex(targets[0]->fileIndex)
-                + "#L" + std::to_string(storage->getPositionFromOffset(targets[0]->charOffset, targets[0]->fileIndex).line + 1);
+            std::string link = storage->getUriFromFileIndex(target->fileIndex)
+                + "#L" + std::to_string(storage->getPositionFromOffset(target->charOffset, target->fileIndex).line + 1);
             result.contents += "- **" + shortname.references[i]->name + ":** [" + shortname.references[i]->targetPath + "](" + link + ")\n";
         }
-        else if(targets.size() > 1)
+        else if(targetCount > 1)
         {
             result.contents += "- **" + shortname.references[i]->name + ":** format error: multiple definitions of reference target\n";
         }
@@ -110,11 +322,11 @@ const lsp::types::Hover lsp::XmlParser::getHover(const lsp::types::TextDocumentP
 
 const lsp::types::LocationLink lsp::XmlParser::getDefinition(const lsp::types::TextDocumentPositionParams &params)
 {
-    auto storage = getStorageForUri(params.textDocument.uri);
-    uint32_t fileIndex = storage->getFileIndex(params.textDocument.uri);
+    uint32_t fileIndex;
+    auto storage = getSnapshot(params.textDocument.uri, fileIndex);
     uint32_t offset = storage->getOffsetFromPosition(params.position, fileIndex) + 2;
     ReferenceElement reference = storage->getReferenceByOffset(offset, fileIndex);
-    ShortnameElement shortname = helper_getShortnameFromInnerPath(storage, reference, offset);
+    ShortnameElement shortname = helper_getShortnameFromInnerPath(*storage, reference, offset);
     
     //The number of '/' between where the user clicked and where the name ends is the number of times we need to get the parent
     lsp::types::LocationLink result;
@@ -128,12 +340,12 @@ const lsp::types::LocationLink lsp::XmlParser::getDefinition(const lsp::types::T
     return result;
 }
 
-std::vector<lsp::types::Location> lsp::XmlParser::getReferences(const lsp::types::ReferenceParams &params)
+std::vector<lsp::types::Location> lsp::XmlParser::getReferences(const lsp::types::ReferenceParams &params, bool linkToParentShortname, const CancellationToken &token)
 {
     std::vector<lsp::types::Location> results;
     
-    auto storage = getStorageForUri(params.textDocument.uri);
-    uint32_t fileIndex = storage->getFileIndex(params.textDocument.uri);
+    uint32_t fileIndex;
+    auto storage = getSnapshot(params.textDocument.uri, fileIndex);
     uint32_t offset = storage->getOffsetFromPosition(params.position, fileIndex) + 2;
     lsp::ShortnameElement elem;
     try
@@ -143,13 +355,15 @@ std::vector<lsp::types::Location> lsp::XmlParser::getReferences(const lsp::types
     catch(const lsp::elementNotFoundException& e)
     {
         auto reference = storage->getReferenceByOffset(offset, fileIndex);
-        elem = helper_getShortnameFromInnerPath(storage, reference, offset);
+        elem = helper_getShortnameFromInnerPath(*storage, reference, offset);
     }
 
-    if(lsp::config::referenceLinkToParentShortname)
+    results.reserve(storage->getReferenceCount(elem));
+    if(linkToParentShortname)
     {
         for(auto &ref: storage->getReferencesByShortname(elem))
         {
+            helper_checkCancelled(token, results.size());
             lsp::types::Location res;
             res.uri = storage->getUriFromFileIndex(ref->fileIndex);
             res.range.start = storage->getPositionFromOffset(ref->owner->charOffset - 1, ref->owner->fileIndex);
@@ -161,6 +375,7 @@ std::vector<lsp::types::Location> lsp::XmlParser::getReferences(const lsp::types
     {
         for(auto &ref: storage->getReferencesByShortname(elem))
         {
+            helper_checkCancelled(token, results.size());
             lsp::types::Location res;
             res.uri = storage->getUriFromFileIndex(ref->fileIndex);
             res.range.start = storage->getPositionFromOffset(ref->charOffset - 2, ref->fileIndex);
@@ -171,26 +386,28 @@ std::vector<lsp::types::Location> lsp::XmlParser::getReferences(const lsp::types
     return results;
 }
 
-std::vector<lsp::types::non_standard::ShortnameTreeElement> lsp::XmlParser::getChildren(const lsp::types::non_standard::GetChildrenParams &params)
+std::vector<lsp::types::non_standard::ShortnameTreeElement> lsp::XmlParser::getChildren(const lsp::types::non_standard::GetChildrenParams &params, const CancellationToken &token)
 {
     std::vector<lsp::types::non_standard::ShortnameTreeElement> results;
     try
     {
-        auto storage = getStorageForUri(params.uri);
+        auto storage = getSnapshot(params.uri);
         auto shortnames = storage->getShortnamesByPathOnly(params.path);
-        for (auto &shortname : shortnames)
+        //Index of the result for every name, to find duplicates
+        std::unordered_map<std::string_view, size_t> resultIndices;
+        for (size_t i = 0; i < shortnames.size(); i++)
         {
+            helper_checkCancelled(token, i);
+            auto &shortname = shortnames[i];
             bool duplicate = false;
             if (!params.unique)
             {
                 //Check for duplicates. No duplicates are possible if the path is unique already
-                for(auto &result : results)
+                auto inserted = resultIndices.emplace(shortname->name, results.size());
+                if (!inserted.second)
                 {
-                    if (!result.name.compare(shortname->name))
-                    {
-                        result.unique = false;
-                        duplicate = true;
-                    }
+                    results[inserted.first->second].unique = false;
+                    duplicate = true;
                 }
             }
             if(!duplicate)
@@ -215,8 +432,8 @@ std::vector<lsp::types::non_standard::ShortnameTreeElement> lsp::XmlParser::getC
 
 lsp::types::Location lsp::XmlParser::getOwner(const lsp::types::non_standard::OwnerParams &params)
 {
-    auto storage = getStorageForUri(params.uri);
-    uint32_t fileIndex = storage->getFileIndex(params.uri);
+    uint32_t fileIndex;
+    auto storage = getSnapshot(params.uri, fileIndex);
     lsp::ReferenceElement elem = storage->getReferenceByOffset(storage->getOffsetFromPosition(params.pos, fileIndex) + 2, fileIndex);
     lsp::types::Location result;
     result.uri = params.uri;
@@ -229,8 +446,8 @@ lsp::types::non_standard::ShortnameTreeElement lsp::XmlParser::getNearestShortna
 {
     lsp::types::non_standard::ShortnameTreeElement elem;
     try {
-        auto storage = getStorageForUri(params.textDocument.uri);
-        uint32_t fileIndex = storage->getFileIndex(params.textDocument.uri);
+        uint32_t fileIndex;
+        auto storage = getSnapshot(params.textDocument.uri, fileIndex);
         auto shortname = storage->getLastShortnameByOffset(storage->getOffsetFromPosition(params.position, fileIndex), fileIndex);
         elem.cState = shortname.children.size() ? 1 : 0;
         elem.name = shortname.name;
@@ -248,8 +465,8 @@ lsp::types::non_standard::ShortnameTreeElement lsp::XmlParser::getNearestShortna
 
 lsp::types::non_standard::ShortnameTreeElement lsp::XmlParser::getParent(const std::string path, const std::string uri)
 {
-    auto storage = getStorageForUri(uri);
-    uint32_t fileIndex = storage->getFileIndex(uri);
+    uint32_t fileIndex;
+    auto storage = getSnapshot(uri, fileIndex);
     auto shortname = storage->getShortnameByFullPath(path, fileIndex);
     lsp::types::non_standard::ShortnameTreeElement retElem;
     if(shortname.parent != nullptr)
@@ -272,53 +489,667 @@ lsp::types::non_standard::ShortnameTreeElement lsp::XmlParser::getParent(const s
 
 void lsp::XmlParser::preParse(const lsp::types::DocumentUri uri)
 {
-    getStorageForUri(uri);
+    getSnapshot(uri);
 }
 
-std::shared_ptr<lsp::ArxmlStorage> lsp::XmlParser::getStorageForUri(const lsp::types::DocumentUri uri)
+std::shared_ptr<const lsp::ArxmlStorage> lsp::XmlParser::getSnapshot(const lsp::types::DocumentUri uri)
+{
+    uint32_t fileIndex;
+    return getSnapshot(uri, fileIndex, false);
+}
+
+std::shared_ptr<const lsp::ArxmlStorage> lsp::XmlParser::getSnapshot(const lsp::types::DocumentUri uri, uint32_t &fileIndex)
+{
+    return getSnapshot(uri, fileIndex, true);
+}
+
+std::shared_ptr<const lsp::ArxmlStorage> lsp::XmlParser::getSnapshot(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto storage = getStorageForUri(uri, fileIndex, requireIndexed);
+        if (storage)
+        {
+            return storage;
+        }
+    }
+    return indexSingleFile(uri, fileIndex, requireIndexed);
+}
+
+std::shared_ptr<const lsp::ArxmlStorage> lsp::XmlParser::getStorageForUri(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed)
 {
     if(uri.find("///", 0) == std::string::npos)
     {
         throw lsp::badUriException();
     }
-    for(auto &element: storages_)
+    auto entry = uris_.find(ArxmlStorage::normalizeUri(uri));
+    if(entry == uris_.end())
     {
-        if(element.storage->containsFile(uri))
-        {
-            element.lastUsedID = helper_getNextUsageID();
-            return element.storage;
-        }      
+        return nullptr;
+    }
+    fileIndex = entry->second.fileIndex;
+    //Someone is looking at this file, so it is indexed next. Until then a storage of its own answers, if it has one,
+    //the placeholder in the folder storage has no positions to answer from
+    if (requireIndexed && prioritizeQueuedFile(uri) && !entry->second.storageElement->singleFile)
+    {
+        throw lsp::elementNotFoundException();
+    }
+    return entry->second.storageElement->storage;
+}
+
+void lsp::XmlParser::addUris(std::list<StorageElement>::iterator storageElement)
+{
+    for (uint32_t fileIndex = 0; fileIndex < storageElement->storage->getFileCount(); fileIndex++)
+    {
+        uris_.emplace(ArxmlStorage::normalizeUri(storageElement->storage->getUriFromFileIndex(fileIndex)), UriEntry{storageElement, fileIndex});
     }
+}
+
+std::shared_ptr<const lsp::ArxmlStorage> lsp::XmlParser::indexSingleFile(const lsp::types::DocumentUri uri, uint32_t &fileIndex, bool requireIndexed)
+{
+    //Scanned without the locks, requests for the files that are known already are answered in the meantime
+    const lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    std::string log;
+    std::atomic<uint32_t> idleThreads(helper_getIndexingThreads(settings) - 1);
+    StagedFile file = scanFile(uri, helper_getIndexCache(settings), settings, idleThreads, log);
+    auto storage = std::make_shared<lsp::ArxmlStorage>();
+    const uint32_t newFileIndex = storage->addFile(std::move(file));
+
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    //Another request or a folder can have added the file while it was scanned, that one is kept
+    auto known = getStorageForUri(uri, fileIndex, requireIndexed);
+    if (known)
+    {
+        return known;
+    }
+    std::cout << log;
     //Need to make sure this only happens when the files in the workspace folder are parsed already, else this file will get its own storage
+    //It is replaced by the folder storage if the file turns out to be in a workspace folder, which then indexes it first
     StorageElement newStorage;
-    newStorage.lastUsedID = helper_getNextUsageID();
-    newStorage.storage = std::make_shared<lsp::ArxmlStorage>();
-    parseSingleFile(uri, newStorage.storage);
+    newStorage.storage = storage;
+    newStorage.singleFile = true;
+    priorityUris_.insert(ArxmlStorage::normalizeUri(uri));
     storages_.push_back(newStorage);
-    return newStorage.storage;
+    addUris(std::prev(storages_.end()));
+    fileIndex = newFileIndex;
+    return storage;
 }
 
-void lsp::XmlParser::parseSingleFile(const std::string uri, std::shared_ptr<ArxmlStorage> storage)
+void lsp::XmlParser::reindexFile(const lsp::types::DocumentUri uri)
 {
-    storage->addFileIndex(uri);
-    uint32_t fileIndex = storage->getFileIndex(uri);
+    reindexFromDisk(uri);
+}
 
-    if (boost::filesystem::file_size(boost::filesystem::path(helper_sanitizeUri(uri))))
+bool lsp::XmlParser::prioritizeFile(const lsp::types::DocumentUri uri)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!uris_.count(ArxmlStorage::normalizeUri(uri)))
+    {
+        priorityUris_.insert(ArxmlStorage::normalizeUri(uri));
+        return false;
+    }
+    prioritizeQueuedFile(uri);
+    return true;
+}
+
+void lsp::XmlParser::reindexFile(const lsp::types::DocumentUri uri, const std::string &content)
+{
+    const uint64_t contentHash = IndexCache::hashContent(content.data(), content.size());
+    if (!prioritizeFile(uri) || !isOutdated(uri, contentHash))
+    {
+        return;
+    }
+    const lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    std::string log;
+    std::atomic<uint32_t> idleThreads(helper_getIndexingThreads(settings) - 1);
+    StagedFile file = scanContent(uri, content.data(), content.size(), contentHash, settings, idleThreads, log);
+    replaceFile(std::move(file), log);
+}
+
+bool lsp::XmlParser::reindexFromDisk(const lsp::types::DocumentUri uri)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!uris_.count(ArxmlStorage::normalizeUri(uri)))
+        {
+            return false;
+        }
+    }
+    //A file that doesn't exist anymore is indexed as empty, so its elements are removed but it can come back later
+    const std::string filePath = helper_sanitizeUri(uri);
+    const lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    std::string log;
+    std::atomic<uint32_t> idleThreads(helper_getIndexingThreads(settings) - 1);
+    StagedFile file;
+    if (boost::filesystem::is_regular_file(filePath) && boost::filesystem::file_size(filePath))
+    {
+        const int64_t modificationTime = boost::filesystem::last_write_time(filePath);
+        boost::iostreams::mapped_file mmap(filePath, boost::iostreams::mapped_file::readonly);
+        const uint64_t contentHash = IndexCache::hashContent(mmap.const_data(), mmap.size());
+        if (!isOutdated(uri, contentHash))
+        {
+            return false;
+        }
+        file = scanContent(uri, mmap.const_data(), mmap.size(), contentHash, settings, idleThreads, log);
+        helper_getIndexCache(settings).store(file, modificationTime, mmap.size());
+        mmap.close();
+    }
+    else
+    {
+        if (!isOutdated(uri, IndexCache::hashContent(nullptr, 0)))
+        {
+            return false;
+        }
+        file = scanContent(uri, nullptr, 0, IndexCache::hashContent(nullptr, 0), settings, idleThreads, log);
+    }
+    replaceFile(std::move(file), log);
+    return true;
+}
+
+uint32_t lsp::XmlParser::updateFolderFiles(std::list<StorageElement>::iterator storageElement, const boost::filesystem::path &directory,
+    const std::vector<std::string> &fileNames, bool rescan)
+{
+    std::set<std::string> uris;
+    for (auto &fileName : fileNames)
+    {
+        uris.insert(helper_makeURI((directory / fileName).generic_string()));
+    }
+    const lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    uint32_t reindexed = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (rescan)
+        {
+            //Files that were removed while events were lost are only known to the storage
+            for (uint32_t fileIndex = 0; fileIndex < storageElement->storage->getFileCount(); fileIndex++)
+            {
+                uris.insert(storageElement->storage->getUriFromFileIndex(fileIndex));
+            }
+        }
+    }
+    //Files are scanned without the lock, so requests are answered in between
+    for (auto &uri : uris)
+    {
+        bool isKnown;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isKnown = storageElement->storage->containsFile(uri);
+        }
+        if (isKnown)
+        {
+            reindexed += reindexFromDisk(uri);
+        }
+        else if (boost::filesystem::is_regular_file(helper_sanitizeUri(uri)))
+        {
+            std::string log;
+            std::atomic<uint32_t> idleThreads(helper_getIndexingThreads(settings) - 1);
+            StagedFile file = scanFile(uri, helper_getIndexCache(settings), settings, idleThreads, log);
+            std::lock_guard<std::mutex> writeLock(writeMutex_);
+            std::shared_ptr<ArxmlStorage> next;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                next = storageElement->storage->nextGeneration();
+            }
+            const uint32_t fileIndex = next->addFile(std::move(file));
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::cout << log;
+            storageElement->storage = next;
+            uris_.emplace(ArxmlStorage::normalizeUri(uri), UriEntry{storageElement, fileIndex});
+            reindexed++;
+        }
+    }
+    std::cout << "Updated " << reindexed << " of " << uris.size() << " changed files in " << directory.generic_string() << "\n\n";
+    return reindexed;
+}
+
+std::vector<lsp::types::non_standard::WatcherStatistics> lsp::XmlParser::getWatcherStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<lsp::types::non_standard::WatcherStatistics> results;
+    for (auto &watcher : watchers_)
+    {
+        FileWatcher::Statistics statistics = watcher->getStatistics();
+        lsp::types::non_standard::WatcherStatistics result;
+        result.directory = watcher->getDirectory();
+        result.running = watcher->isRunning();
+        result.eventsReceived = statistics.eventsReceived;
+        result.bursts = statistics.bursts;
+        result.filesReindexed = statistics.filesReindexed;
+        result.reindexTime = statistics.reindexMicroseconds / 1000;
+        results.push_back(result);
+    }
+    return results;
+}
+
+bool lsp::XmlParser::isOutdated(const lsp::types::DocumentUri uri, const uint64_t contentHash)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &storageElement : storages_)
+    {
+        if (storageElement.storage->containsFile(uri))
+        {
+            if (storageElement.storage->getContentHash(storageElement.storage->getFileIndex(uri)) != contentHash)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void lsp::XmlParser::replaceFile(StagedFile &&file, const std::string &log)
+{
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    const std::string uri = file.uri;
+    std::vector<std::pair<IndexingJob*, uint32_t>> queuedFiles;
+    std::vector<std::string> targetNames;
+    std::vector<StorageElement*> storageElements;
+    std::vector<std::shared_ptr<ArxmlStorage>> nextGenerations;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        //The background indexing doesn't need to index a file that is replaced anyway
+        for (auto &job : indexingJobs_)
+        {
+            if (job.storageElement->storage->containsFile(uri))
+            {
+                const uint32_t fileIndex = job.storageElement->storage->getFileIndex(uri);
+                if (job.unindexed.count(fileIndex))
+                {
+                    queuedFiles.emplace_back(&job, fileIndex);
+                    if (job.prioritized.count(fileIndex))
+                    {
+                        targetNames = helper_getTargetNames(file);
+                    }
+                }
+            }
+        }
+        for (auto &storageElement : storages_)
+        {
+            if (storageElement.storage->containsFile(uri))
+            {
+                storageElements.push_back(&storageElement);
+                nextGenerations.push_back(storageElement.storage->nextGeneration());
+            }
+        }
+    }
+    //Built without the lock, requests are answered from the current generations until the new ones are published
+    std::string replaced;
+    for (size_t i = 0; i < nextGenerations.size(); i++)
     {
-        boost::iostreams::mapped_file mmap(helper_sanitizeUri(uri), boost::iostreams::mapped_file::readonly);
-        std::cout << "Parsing " << uri << "\n";
         auto t0 = std::chrono::high_resolution_clock::now();
-        parseNewlines(mmap, storage, fileIndex);
+        const uint32_t fileIndex = nextGenerations[i]->getFileIndex(uri);
+        //Only the last storage can take the scan result, the others get a copy
+        nextGenerations[i]->replaceFile(fileIndex, i + 1 < nextGenerations.size() ? StagedFile(file) : std::move(file));
         auto t1 = std::chrono::high_resolution_clock::now();
-        std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms - Newlines\n";
-        auto t2 = std::chrono::high_resolution_clock::now();
-        parseShortnamesAndReferences(mmap, storage, fileIndex);
-        auto t3 = std::chrono::high_resolution_clock::now();
-        std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << "ms - Shortnames/References\n\n";
+        replaced += std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count()) + "ms - Replaced file "
+            + std::to_string(fileIndex) + " of " + std::to_string(nextGenerations[i]->getFileCount()) + " in the storage\n";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::cout << log << replaced;
+    for (size_t i = 0; i < nextGenerations.size(); i++)
+    {
+        storageElements[i]->storage = nextGenerations[i];
+    }
+    for (auto &queuedFile : queuedFiles)
+    {
+        dequeueFile(*queuedFile.first, queuedFile.second, uri, targetNames);
+    }
+}
+
+bool lsp::XmlParser::prioritizeQueuedFile(const lsp::types::DocumentUri uri)
+{
+    for (auto &job : indexingJobs_)
+    {
+        if (job.storageElement->storage->containsFile(uri))
+        {
+            const uint32_t fileIndex = job.storageElement->storage->getFileIndex(uri);
+            if (job.unindexed.count(fileIndex))
+            {
+                auto queued = std::find(job.queue.begin(), job.queue.end(), fileIndex);
+                if (queued != job.queue.end())
+                {
+                    job.queue.erase(queued);
+                    job.queue.push_front(fileIndex);
+                }
+                job.prioritized.insert(fileIndex);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void lsp::XmlParser::dequeueFile(IndexingJob &job, const uint32_t fileIndex, const lsp::types::DocumentUri &uri, const std::vector<std::string> &targetNames)
+{
+    job.unindexed.erase(fileIndex);
+    auto queued = std::find(job.queue.begin(), job.queue.end(), fileIndex);
+    if (queued != job.queue.end())
+    {
+        job.queue.erase(queued);
+    }
+    job.targetNames.insert(targetNames.begin(), targetNames.end());
+    auto entry = uris_.find(ArxmlStorage::normalizeUri(uri));
+    if (entry != uris_.end() && entry->second.storageElement != job.storageElement && entry->second.storageElement->singleFile)
+    {
+        storages_.erase(entry->second.storageElement);
+        entry->second = UriEntry{job.storageElement, fileIndex};
+    }
+}
+
+bool lsp::XmlParser::isBatchReady(const IndexingJob &job)
+{
+    if (job.scanned.empty())
+    {
+        return false;
+    }
+    if (job.queue.empty() || stopIndexing_)
+    {
+        return true;
+    }
+    for (auto &scanned : job.scanned)
+    {
+        if (job.prioritized.count(scanned.fileIndex))
+        {
+            return true;
+        }
+    }
+    //Batches grow with the storage, so every file is only copied a constant number of times on average
+    const uint32_t published = job.storageElement->storage->getFileCount() - job.unindexed.size();
+    return job.scanned.size() * publishBatchDivisor >= published;
+}
+
+void lsp::XmlParser::publishScanned(IndexingJob &job, const std::vector<std::string> &uris)
+{
+    while (true)
+    {
+        std::lock_guard<std::mutex> writeLock(writeMutex_);
+        std::vector<ScannedFile> batch;
+        std::vector<std::vector<std::string>> targetNames;
+        std::shared_ptr<ArxmlStorage> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isBatchReady(job))
+            {
+                job.publishing = false;
+                return;
+            }
+            for (auto &scanned : job.scanned)
+            {
+                //An opened document can have been indexed from its content in the meantime
+                if (!job.unindexed.count(scanned.fileIndex))
+                {
+                    std::cout << scanned.log;
+                    continue;
+                }
+                targetNames.push_back(job.prioritized.count(scanned.fileIndex) ? helper_getTargetNames(scanned.file) : std::vector<std::string>());
+                batch.push_back(std::move(scanned));
+            }
+            job.scanned.clear();
+            next = job.storageElement->storage->nextGeneration();
+        }
+        for (auto &scanned : batch)
+        {
+            next->replaceFile(scanned.fileIndex, std::move(scanned.file));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &scanned : batch)
+        {
+            std::cout << scanned.log;
+        }
+        job.storageElement->storage = next;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            dequeueFile(job, batch[i].fileIndex, uris[batch[i].fileIndex], targetNames[i]);
+        }
+    }
+}
+
+void lsp::XmlParser::prioritizeTargets(IndexingJob &job, const std::vector<std::string> &uris)
+{
+    std::unordered_set<std::string> targetNames;
+    std::vector<uint32_t> candidates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (job.targetNames.empty())
+        {
+            return;
+        }
+        targetNames.swap(job.targetNames);
+        candidates.assign(job.queue.begin(), job.queue.end());
+    }
+    auto t0 = std::chrono::high_resolution_clock::now();
+    const std::unordered_set<std::string_view> names(targetNames.begin(), targetNames.end());
+    std::unordered_set<uint32_t> targetFiles;
+    for (auto fileIndex : candidates)
+    {
+        if (helper_definesShortname(helper_sanitizeUri(uris[fileIndex]), names))
+        {
+            targetFiles.insert(fileIndex);
+        }
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::deque<uint32_t> queue;
+    std::copy_if(job.queue.begin(), job.queue.end(), std::back_inserter(queue), [&](uint32_t fileIndex) { return targetFiles.count(fileIndex); });
+    std::copy_if(job.queue.begin(), job.queue.end(), std::back_inserter(queue), [&](uint32_t fileIndex) { return !targetFiles.count(fileIndex); });
+    job.queue.swap(queue);
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms - Moved " << targetFiles.size() << " of "
+        << candidates.size() << " queued files defining " << names.size() << " reference targets to the front\n\n";
+}
+
+lsp::StagedFile lsp::XmlParser::scanFile(const std::string uri, const IndexCache &cache, const lsp::config::IndexSettings &settings,
+    std::atomic<uint32_t> &idleThreads, std::string &log)
+{
+    StagedFile file;
+    const std::string filePath = helper_sanitizeUri(uri);
+    auto tLoad = std::chrono::high_resolution_clock::now();
+    if (cache.load(uri, filePath, file))
+    {
+        std::ostringstream logStream;
+        logStream << "Loaded " << uri << " from the index cache ("
+            << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - tLoad).count() << "ms)\n\n";
+        log = logStream.str();
+        return file;
+    }
+
+    if (boost::filesystem::file_size(boost::filesystem::path(filePath)))
+    {
+        //Taken before reading, so a write during the scan makes the cache entry stale instead of wrong
+        const int64_t modificationTime = boost::filesystem::last_write_time(filePath);
+        boost::iostreams::mapped_file mmap(filePath, boost::iostreams::mapped_file::readonly);
+        file = scanContent(uri, mmap.const_data(), mmap.size(), IndexCache::hashContent(mmap.const_data(), mmap.size()), settings, idleThreads, log);
+        cache.store(file, modificationTime, mmap.size());
         mmap.close();
+        return file;
+    }
+    return scanContent(uri, nullptr, 0, IndexCache::hashContent(nullptr, 0), settings, idleThreads, log);
+}
+
+lsp::StagedFile lsp::XmlParser::scanContent(const std::string uri, const char *const start, const uint64_t size, const uint64_t contentHash,
+    const lsp::config::IndexSettings &settings, std::atomic<uint32_t> &idleThreads, std::string &log)
+{
+    StagedFile file;
+    file.uri = uri;
+    file.contentHash = contentHash;
+    file.newlineOffsets.push_back(0);
+
+    if (size)
+    {
+        //Collect the output and let the caller print it, so the timings of files scanned in parallel don't interleave
+        std::ostringstream logStream;
+        const char *const end = start + size;
+        logStream << "Parsing " << uri << "\n";
+
+        //The scanning thread plus the idle ones it can get, it never uses more than the configured indexing threads
+        const uint32_t borrowedThreads = size >= settings.chunkedParsingMinFileSize ? helper_borrowThreads(idleThreads, helper_getIndexingThreads(settings) - 1) : 0;
+        if (borrowedThreads)
+        {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            std::vector<const char*> boundaries = helper_getChunkBoundaries(start, end, borrowedThreads + 1);
+            bool stitched;
+            try
+            {
+                stitched = scanChunked(start, boundaries, file, borrowedThreads + 1);
+            }
+            catch (...)
+            {
+                idleThreads += borrowedThreads;
+                throw;
+            }
+            idleThreads += borrowedThreads;
+            if (stitched)
+            {
+                auto t1 = std::chrono::high_resolution_clock::now();
+                logStream << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms - Newlines/Shortnames/References in 1 pass ("
+                    << boundaries.size() - 1 << " chunks, " << helper_formatThroughput(size, t1 - t0) << ")\n\n";
+                log = logStream.str();
+                return file;
+            }
+            logStream << "Chunk borders could not be stitched, parsing serially\n";
+            file.newlineOffsets.resize(1);
+        }
+
+        ScannedChunk chunk;
+        chunk.newlineOffsets.swap(file.newlineOffsets);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        scanRange(start, start, end, end, chunk);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        logStream << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms - Newlines/Shortnames/References in 1 pass ("
+            << helper_formatThroughput(size, t1 - t0) << ")\n\n";
+        //A single chunk starting at the beginning of the file has nothing open before it, so the local indices are already final
+        file.newlineOffsets.swap(chunk.newlineOffsets);
+        file.shortnames = std::move(chunk.shortnames);
+        file.references = std::move(chunk.references);
+        log = logStream.str();
+    }
+    return file;
+}
+
+bool lsp::XmlParser::scanChunked(const char *const start, const std::vector<const char*> &boundaries, StagedFile &file, uint32_t numThreads)
+{
+    const size_t numChunks = boundaries.size() - 1;
+    const char *const end = boundaries.back();
+    std::vector<ScannedChunk> chunks(numChunks);
+
+    helper_parallelFor(numChunks, numThreads, [&](size_t chunkNr)
+    {
+        scanRange(start, boundaries[chunkNr], boundaries[chunkNr + 1], end, chunks[chunkNr]);
+    });
+
+    //A chunk has to end exactly where the next one starts, else the border was inside something the serial parser skips (e.g. a comment)
+    for (size_t chunkNr = 0; chunkNr < numChunks; chunkNr++)
+    {
+        if (chunks[chunkNr].endPosition != boundaries[chunkNr + 1])
+            return false;
+    }
+
+    //Walk the chunk summaries to get the elements that are open at the start of each chunk. This only touches the
+    //elements that are still open at chunk borders, all the per element work is done in parallel afterwards
+    std::vector<std::vector<OpenElement>> openElements(numChunks);
+    std::vector<int64_t> startDepths(numChunks);
+    std::vector<int32_t> firstIndices(numChunks);
+    std::vector<OpenElement> stack;
+    int64_t depth = 0;
+    int32_t index = 0;
+    for (size_t chunkNr = 0; chunkNr < numChunks; chunkNr++)
+    {
+        ScannedChunk &chunk = chunks[chunkNr];
+        openElements[chunkNr] = stack;
+        startDepths[chunkNr] = depth;
+        firstIndices[chunkNr] = index;
+
+        if (chunk.incomingPopDepth != INT64_MAX)
+        {
+            while (!stack.empty() && stack.back().depth > depth + chunk.incomingPopDepth)
+                stack.pop_back();
+        }
+        for (auto &element : chunk.depthElements)
+        {
+            stack.push_back(OpenElement{depth + element.first, index + element.second, &chunk.shortnames[element.second].name});
+        }
+        depth += chunk.endDepth;
+        index += chunk.shortnames.size();
+    }
+
+    helper_parallelFor(numChunks, numThreads, [&](size_t chunkNr)
+    {
+        fixupChunk(chunks[chunkNr], openElements[chunkNr], startDepths[chunkNr], firstIndices[chunkNr]);
+    });
+
+    file.shortnames.reserve(index);
+    for (auto &chunk : chunks)
+    {
+        file.newlineOffsets.insert(file.newlineOffsets.end(), chunk.newlineOffsets.begin(), chunk.newlineOffsets.end());
+        std::move(chunk.shortnames.begin(), chunk.shortnames.end(), std::back_inserter(file.shortnames));
+        std::move(chunk.references.begin(), chunk.references.end(), std::back_inserter(file.references));
     }
+    return true;
 }
 
+void lsp::XmlParser::fixupChunk(ScannedChunk &chunk, const std::vector<OpenElement> &openElements, int64_t startDepth, int32_t firstIndex)
+{
+    //The pop depths only ever decrease during a chunk, so the open elements can be popped incrementally
+    size_t numOpen = openElements.size();
+    int64_t poppedTo = INT64_MAX;
+    std::string prefix;
+    size_t prefixLength = SIZE_MAX;
+    auto popOpenElements = [&](int64_t popDepth)
+    {
+        if (popDepth < poppedTo)
+        {
+            while (numOpen && openElements[numOpen - 1].depth > startDepth + popDepth)
+                --numOpen;
+            poppedTo = popDepth;
+        }
+        if (numOpen != prefixLength)
+        {
+            prefix.clear();
+            for (size_t i = 0; i < numOpen; i++)
+            {
+                prefix += *(openElements[i].name) + "/";
+            }
+            if (prefix.size())
+                prefix.pop_back();
+            prefixLength = numOpen;
+        }
+    };
+
+    for (size_t i = 0; i < chunk.shortnames.size(); i++)
+    {
+        StagedShortname &element = chunk.shortnames[i];
+        popOpenElements(chunk.shortnameIncomingPopDepths[i]);
+        if (element.parent >= 0)
+        {
+            element.parent += firstIndex;
+            if (numOpen)
+                element.path = prefix + "/" + element.path;
+        }
+        else
+        {
+            element.parent = numOpen ? openElements[numOpen - 1].index : -1;
+            element.path = prefix;
+        }
+    }
+
+    numOpen = openElements.size();
+    poppedTo = INT64_MAX;
+    for (size_t i = 0; i < chunk.references.size(); i++)
+    {
+        StagedReference &reference = chunk.references[i];
+        if (reference.owner >= 0)
+        {
+            reference.owner += firstIndex;
+        }
+        else
+        {
+            popOpenElements(chunk.referenceIncomingPopDepths[i]);
+            reference.owner = numOpen ? openElements[numOpen - 1].index : -1;
+        }
+    }
+}
 void lsp::XmlParser::parseFullFolder(const lsp::types::DocumentUri uri)
 {
     std::string sanitizedFilePath = std::string(uri.begin(), uri.end());
@@ -327,113 +1158,262 @@ void lsp::XmlParser::parseFullFolder(const lsp::types::DocumentUri uri)
     sanitizedFilePath = sanitizedFilePath.substr(colonPos - 1);
     boost::filesystem::path path(sanitizedFilePath);
 
-    StorageElement newStorage;
-    newStorage.lastUsedID = helper_getNextUsageID();
-    newStorage.storage = std::make_shared<lsp::ArxmlStorage>();
+    if(!boost::filesystem::is_directory(path))
+    {
+        throw lsp::elementNotFoundException();
+    }
+    std::vector<std::string> files = helper_getARXMLFilePathsInDirectory(path);
+    std::vector<std::string> uris;
+    for (auto &file : files)
+    {
+        uris.push_back(helper_makeURI(file));
+    }
 
-    if(boost::filesystem::is_directory(path))
+    //Used for the whole folder, a configuration arriving meanwhile applies to the next job
+    const lsp::config::IndexSettings settings = lsp::config::getIndexSettings();
+    auto storage = std::make_shared<lsp::ArxmlStorage>();
+    std::list<StorageElement>::iterator storageElement;
+    std::list<IndexingJob>::iterator job;
     {
-        std::vector<std::string> files = helper_getARXMLFilePathsInDirectory(path);
-        for( auto &file : files)
+        std::lock_guard<std::mutex> lock(mutex_);
+        //Every file is added empty first, so the fileIndices are in directory order no matter in which order the files are scanned,
+        //and requests for them already find the storage of the folder
+        for (auto &fileUri : uris)
+        {
+            StagedFile placeholder;
+            placeholder.uri = fileUri;
+            placeholder.newlineOffsets.push_back(0);
+            placeholder.contentHash = IndexCache::hashContent(nullptr, 0);
+            storage->addFile(std::move(placeholder));
+        }
+        StorageElement newStorage;
+            newStorage.storage = storage;
+        newStorage.singleFile = false;
+        storages_.push_back(newStorage);
+        storageElement = std::prev(storages_.end());
+        //Files that already have a storage of their own keep it until the folder indexed them
+        addUris(storageElement);
+
+        //Files that were opened or requested before go first, the rest in directory order
+        IndexingJob newJob;
+        newJob.storageElement = storageElement;
+        for (uint32_t fileIndex = 0; fileIndex < uris.size(); fileIndex++)
+        {
+            auto priorityUri = priorityUris_.find(ArxmlStorage::normalizeUri(uris[fileIndex]));
+            if (priorityUri != priorityUris_.end())
+            {
+                priorityUris_.erase(priorityUri);
+                newJob.queue.push_front(fileIndex);
+                newJob.prioritized.insert(fileIndex);
+            }
+            else
+            {
+                newJob.queue.push_back(fileIndex);
+            }
+            newJob.unindexed.insert(fileIndex);
+        }
+        job = indexingJobs_.insert(indexingJobs_.end(), std::move(newJob));
+
+        //Watched from the start, so files changing while the folder is indexed are not missed
+        if (settings.watchWorkspaceFolders)
         {
-            parseSingleFile(helper_makeURI(file), newStorage.storage);
+            watchers_.push_back(std::make_unique<FileWatcher>(path.string(), ".arxml",
+                [this, storageElement, path](const std::vector<std::string> &fileNames, bool rescan)
+                {
+                    return updateFolderFiles(storageElement, path, fileNames, rescan);
+                },
+                std::chrono::milliseconds(settings.fileWatcherDebounceTime)));
         }
     }
-    else
+
+    //Files are scanned without the lock, it is only taken to take the next file from the queue and to publish the result
+    const IndexCache cache = helper_getIndexCache(settings);
+    const uint32_t numThreads = std::max<uint32_t>(std::min<uint32_t>(helper_getIndexingThreads(settings), uris.size()), 1);
+    //Threads of the pool without a file to scan. A large file is scanned in chunks only with these, so the folder never uses more threads
+    //than configured: the ones a small folder doesn't need and the workers that ran out of files
+    std::atomic<uint32_t> idleThreads(helper_getIndexingThreads(settings) - numThreads);
+    //Returns false once there is no file left to take
+    auto indexNextFile = [&]()
     {
-        throw lsp::elementNotFoundException();
-    }
-    storages_.push_back(newStorage);
+        prioritizeTargets(*job, uris);
+        uint32_t fileIndex;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopIndexing_ || job->queue.empty())
+            {
+                return false;
+            }
+            fileIndex = job->queue.front();
+            job->queue.pop_front();
+        }
+        std::string log;
+        StagedFile file;
+        try
+        {
+            file = scanFile(uris[fileIndex], cache, settings, idleThreads, log);
+        }
+        catch (const std::exception &e)
+        {
+            //The file stays empty, the file watcher indexes it again when it changes
+            log = "Could not index " + uris[fileIndex] + ": " + e.what() + "\n\n";
+            file = StagedFile();
+            file.uri = uris[fileIndex];
+            file.newlineOffsets.push_back(0);
+            file.contentHash = IndexCache::hashContent(nullptr, 0);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->scanned.push_back(ScannedFile{fileIndex, std::move(file), std::move(log)});
+            if (job->publishing || !isBatchReady(*job))
+            {
+                return true;
+            }
+            job->publishing = true;
+        }
+        publishScanned(*job, uris);
+        return true;
+    };
+    auto t0 = std::chrono::high_resolution_clock::now();
+    helper_parallelFor(numThreads, numThreads, [&](size_t)
+    {
+        while (indexNextFile())
+        {
+        }
+        idleThreads++;
+    });
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms - Indexed "
+        << uris.size() - job->unindexed.size() << " of " << uris.size() << " files using " << numThreads << " thread(s)\n\n";
+    uint32_t unresolvedReferences = 0;
+    uint32_t ambiguousReferences = 0;
+    storageElement->storage->countUnresolvedReferences(unresolvedReferences, ambiguousReferences);
+    std::cout << unresolvedReferences << " references unresolved, " << ambiguousReferences << " ambiguous\n\n";
+    indexingJobs_.erase(job);
 }
 
-void lsp::XmlParser::parseNewlines(boost::iostreams::mapped_file &mmap, std::shared_ptr<ArxmlStorage> storage, uint32_t fileIndex)
+void lsp::XmlParser::parseFoldersInBackground(const std::vector<lsp::types::DocumentUri> &uris, std::function<void()> onFinished)
 {
-    const char *const start = mmap.const_data();
-    const char *current = start;
-    const char *const end = current + mmap.size();
-
-    if (current)
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (foldersIndexed_)
     {
-        //First, go through once and count the number, so we can reserve enough space
-        uint32_t numLines = std::count(start, end, '\n');
-        storage->reserveNewlineOffsets(numLines + 1, fileIndex);
-        storage->addNewlineOffset(0, fileIndex);
-
-        while (current && current < end)
+        lock.unlock();
+        onFinished();
+        return;
+    }
+    onFoldersIndexed_.push_back(onFinished);
+    if (foldersQueued_)
+    {
+        return;
+    }
+    foldersQueued_ = true;
+    indexingThreads_.emplace_back([this, uris]()
+    {
+        for (auto &uri : uris)
         {
-            current = static_cast<const char *>(memchr(current, '\n', end - current));
-            if (current)
+            try
+            {
+                parseFullFolder(uri);
+            }
+            catch (const std::exception &e)
             {
-                storage->addNewlineOffset(current - start, fileIndex);
-                ++current;
+                std::cout << "Could not index " << uri << ": " << e.what() << "\n\n";
+            }
+            if (stopIndexing_)
+            {
+                return;
             }
         }
-    }
+        std::vector<std::function<void()>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            foldersIndexed_ = true;
+            callbacks.swap(onFoldersIndexed_);
+        }
+        for (auto &callback : callbacks)
+        {
+            callback();
+        }
+    });
 }
 
-enum class tagType
+lsp::XmlParser::~XmlParser()
 {
-    opening_tag,
-    closing_tag,
-    shortname,
-    reference,
-    undefined_tag,
-};
+    stopIndexing_ = true;
+    for (auto &thread : indexingThreads_)
+    {
+        thread.join();
+    }
+}
 
-void lsp::XmlParser::parseShortnamesAndReferences(boost::iostreams::mapped_file &mmap, std::shared_ptr<ArxmlStorage> storage, uint32_t fileIndex)
+void lsp::XmlParser::scanRange(const char *const start, const char *const rangeBegin, const char *const rangeEnd, const char *const end, ScannedChunk &chunk)
 {
     tagType lastTag = tagType::undefined_tag;
     tagType currentTag = tagType::undefined_tag;
-    const char *const start = mmap.const_data();
-    const char *current = start;
-    const char *const end = current + mmap.size();
+    const char *current = rangeBegin;
 
-    uint32_t depth = 0;
-    std::vector<std::pair<std::uint32_t, const lsp::ShortnameElement*>> depthElements;
+    //Depth relative to the start of the range. Chunks never start with a tag that depends on the tags before it,
+    //so the only unknowns are the elements that were open before the range, which get resolved when stitching the chunks
+    int64_t depth = 0;
+    //Depth and index of the staged shortname
+    std::vector<std::pair<int64_t, int32_t>> &depthElements = chunk.depthElements;
+    chunk.incomingPopDepth = INT64_MAX;
 
-    //Preparation for reference parsing
-    const std::string searchPattern = "DEST";
-    std::boyer_moore_searcher searcher(searchPattern.begin(), searchPattern.end());
+    //Collects the newlines of every block it goes through, so the file only has to be read from memory once
+    StructuralScanner scanner(start, rangeBegin, rangeEnd, end, chunk.newlineOffsets);
 
-    while (current && current < end)
+    while (current && current < rangeEnd)
     {
         //Go to the next tag
-        current = static_cast<const char*>(memchr(current, '<', end - current));
+        current = scanner.findTagOpen(current, rangeEnd);
         if (!current)
+        {
+            current = rangeEnd;
             break;
+        }
         ++current;
+        if (current >= end)
+            break;
 
         ///////////////////
         /// parsing tag ///
         ///////////////////
 
-        /// comment - skip ///
+        /// comment or CDATA section - skip ///
         if(*(current) == '!')
         {
             ++current;
-            current = strstr(current, "-->") + 3;
+            //Both can contain tags, a comment ends with "-->" and a CDATA section with "]]>". One that is never closed hides the rest of the file
+            const char closing = (end - current >= 7 && !memcmp(current, "[CDATA[", 7)) ? ']' : '-';
+            const char *commentEnd = scanner.findTagClose(current + 2);
+            while (commentEnd && (*(commentEnd - 1) != closing || *(commentEnd - 2) != closing))
+                commentEnd = scanner.findTagClose(commentEnd + 1);
+            current = commentEnd ? commentEnd + 1 : end;
         }
 
         /// xml info - skip ///
         else if(*(current) == '?')
         {
             ++current;
-            current = strstr(current, "?>") + 2;
+            const char *infoEnd = scanner.findTagClose(current + 1);
+            while (infoEnd && *(infoEnd - 1) != '?')
+                infoEnd = scanner.findTagClose(infoEnd + 1);
+            current = infoEnd ? infoEnd + 1 : end;
         }
 
         /// closing tag - decrease depth ///
-        else if (*(current) == '/')
+        else if (scanner.isSlash(current))
         {
             if (currentTag == tagType::shortname && lastTag == tagType::opening_tag)
             {
-                static const std::string ident_compare = "IDENT>";
-                std::string tagContent(current + 1, 6);
-                if(!ident_compare.compare(tagContent))
+                if (end - current > 6 && !memcmp(current + 1, "IDENT>", 6))
                     --(depthElements.back().first);
             }
             --depth;
             ++current;
-            current = static_cast<const char *>(memchr(current, '>', end - current)) + 1;
+            current = scanner.findTagClose(current) + 1;
             //if we have the form <open><shortname>name</shortname></open> then we want to ignore the open tag in the depth calculation
             //in order to associate name with other elements of that depth, but name would be getting removed from the depthElements because of the indentation
             if (!depthElements.empty())
@@ -445,29 +1425,44 @@ void lsp::XmlParser::parseShortnamesAndReferences(boost::iostreams::mapped_file
                         break;
                 }
             }
+            //Once our own elements are gone, the same happens to the elements open before the range
+            if (depthElements.empty())
+            {
+                chunk.incomingPopDepth = std::min(chunk.incomingPopDepth, depth);
+            }
             lastTag = currentTag;
             currentTag = tagType::closing_tag;
         }
         /// opening tag ///
         else
         {
-            const char* tagEnd = static_cast<const char*>(memchr(current, '>', end - current));
-            std::string tagContent(current, tagEnd);
+            //Remember the quotes on the way to the end of the tag, they enclose the name of a reference
+            const char *firstQuote = nullptr;
+            const char *lastQuote = nullptr;
+            const char *tagEnd = scanner.findQuoteOrTagClose(current);
+            while (tagEnd && *tagEnd == '"')
+            {
+                if (!firstQuote)
+                    firstQuote = tagEnd;
+                lastQuote = tagEnd;
+                tagEnd = scanner.findQuoteOrTagClose(tagEnd + 1);
+            }
+            const tagType openedTag = helper_classifyOpeningTag(std::string_view(current, tagEnd - current));
 
             /// shortname ///
-            if (!tagContent.compare("SHORT-NAME"))
+            if (openedTag == tagType::shortname)
             {
-                ShortnameElement element;
-                element.parent = nullptr;
+                StagedShortname element;
+                element.parent = -1;
 
                 // skip to the end of the <SHORT-NAME> tag
                 current += 11;
 
-                const char *endChar = static_cast<const char*>(memchr(current, '<', end - current));
+                const char *endChar = scanner.findTagOpen(current, end);
                 std::string pathString = "";
                 for (auto i : depthElements)
                 {
-                    pathString += i.second->name + "/";
+                    pathString += chunk.shortnames[i.second].name + "/";
                 }
                 if(pathString.size())
                 {
@@ -478,50 +1473,40 @@ void lsp::XmlParser::parseShortnamesAndReferences(boost::iostreams::mapped_file
                 element.name = std::string(current, static_cast<uint32_t>(endChar - current));
                 element.path = pathString;
                 element.charOffset = current - start;
-                element.fileIndex = fileIndex;
 
-                const ShortnameElement* elementPtr = storage->addShortname(element);
-                if(depthElements.size())
-                {
-                    depthElements.back().second->children.push_back(elementPtr);
-                }
-                depthElements.push_back(std::make_pair(depth, elementPtr));
+                depthElements.push_back(std::make_pair(depth, static_cast<int32_t>(chunk.shortnames.size())));
+                chunk.shortnames.push_back(std::move(element));
+                chunk.shortnameIncomingPopDepths.push_back(chunk.incomingPopDepth);
 
                 current = endChar + 13;
                 lastTag = currentTag;
                 currentTag = tagType::shortname;
             }
             /// reference ///
-            else if (std::search(tagContent.begin(), tagContent.end(), searcher) != tagContent.end())
+            else if (openedTag == tagType::reference)
             {
-                current = static_cast<const char *>(memchr(current, '>', end - current)) + 2;
-                const char* endOfReference = static_cast<const char*>(memchr(current, '<', end - current));
+                StagedReference reference;
+                //The name is between the first and the last quote, the whole tag if there are none
+                const char *nameBegin = firstQuote ? firstQuote + 1 : current;
+                const char *nameEnd = lastQuote > firstQuote ? lastQuote : tagEnd;
+                reference.name = std::string(nameBegin, nameEnd);
 
-                ReferenceElement reference;
-                auto nameBeginIndex = tagContent.find_first_of('\"') + 1;
-                reference.name = tagContent.substr(nameBeginIndex, tagContent.find_last_of('\"') - nameBeginIndex);
-                std::string refString = std::string(current, endOfReference);
-                reference.targetPath = refString;
+                current = tagEnd + 2;
+                const char* endOfReference = scanner.findTagOpen(current, end);
+                reference.targetPath = std::string(current, endOfReference);
                 reference.charOffset = current - start;
-                reference.owner = nullptr;
-                reference.fileIndex = fileIndex;
-                if(depthElements.size())
-                {
-                    reference.owner = depthElements.back().second;
-                    depthElements.back().second->references.push_back(storage->addReference(reference));
-                }
-                else
-                {
-                    storage->addReference(reference);
-                }
-                current = static_cast<const char*>(memchr(current, '>', end - current));
+                reference.owner = depthElements.size() ? depthElements.back().second : -1;
+                chunk.references.push_back(std::move(reference));
+                chunk.referenceIncomingPopDepths.push_back(chunk.incomingPopDepth);
+
+                current = scanner.findTagClose(current);
                 lastTag = currentTag;
                 currentTag = tagType::reference;
             }
             /// random tag - increase depth and skip ///
             else
             {
-                current = static_cast<const char*>(memchr(current, '>', end - current)) + 1;
+                current = tagEnd + 1;
                 if (*(current - 2) != '/')
                 {
                     ++depth;
@@ -531,4 +1516,7 @@ void lsp::XmlParser::parseShortnamesAndReferences(boost::iostreams::mapped_file
             }
         } 
     }
-}
\ No newline at end of file
+    scanner.finish();
+    chunk.endPosition = current;
+    chunk.endDepth = depth;
+}
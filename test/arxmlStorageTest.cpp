@@ -0,0 +1,62 @@
+#include <string>
+#include <memory>
+
+#include "arxmlStorage.hpp"
+#include "check.hpp"
+
+//A file with a package, an element named by version and a reference to the element, like a document that is edited
+lsp::StagedFile helper_makeFile(uint32_t version)
+{
+    const std::string element = "Element" + std::to_string(version);
+    lsp::StagedFile file;
+    file.uri = "file:///c%3A/edited.arxml";
+    file.newlineOffsets = {0};
+    file.shortnames = {
+        {"Package", "", 10, -1},
+        {element, "Package", 20, 0},
+    };
+    file.references = {{"TYPE", "/Package/" + element, 30, 1}};
+    file.contentHash = version;
+    return file;
+}
+
+bool helper_hasPath(const lsp::ArxmlStorage &storage, const std::string &path)
+{
+    return storage.findPathId(path).has_value();
+}
+
+//Every edit of a document interns new paths, the ones no generation uses anymore have to be released
+void testPathsReleased()
+{
+    auto storage = std::make_shared<lsp::ArxmlStorage>();
+    storage->addFile(helper_makeFile(0));
+    //A request still answering from the first generation
+    std::shared_ptr<const lsp::ArxmlStorage> reader = storage;
+
+    for (uint32_t version = 1; version <= 1000; version++)
+    {
+        std::shared_ptr<lsp::ArxmlStorage> next = storage->nextGeneration();
+        next->replaceFile(0, helper_makeFile(version));
+        storage = next;
+    }
+
+    CHECK(helper_hasPath(*storage, "Package/Element1000"));
+    CHECK(storage->getShortnamesByFullPath("Package/Element1000").size() == 1);
+    CHECK(!helper_hasPath(*storage, "Package/Element500"));
+    //Released ids are reused, so the ids stay as few as the paths in use
+    CHECK(storage->getPathId("Package/Element1000") < 16);
+
+    //The first generation keeps its paths as long as it is used
+    CHECK(helper_hasPath(*reader, "Package/Element0"));
+    CHECK(reader->getShortnameByFullPath("Package/Element0", 0).getFullPath() == "Package/Element0");
+    CHECK(reader->getShortnamesByFullPath("Package/Element1000").empty());
+    reader.reset();
+    CHECK(!helper_hasPath(*storage, "Package/Element0"));
+    CHECK(helper_hasPath(*storage, "Package"));
+}
+
+int main()
+{
+    testPathsReleased();
+    return CHECK_RESULT();
+}
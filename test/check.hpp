@@ -0,0 +1,30 @@
+/**
+ * @file check.hpp
+ * @brief Minimal checks for the tests, a failed check is printed and makes the test return non-zero
+ * @version 0.1
+ * @date 2026-10-17
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+
+namespace lsp::test
+{
+    inline int failures = 0;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            lsp::test::failures++; \
+        } \
+    } while (0)
+
+#define CHECK_RESULT() (lsp::test::failures ? 1 : 0)
+
+#endif /* CHECK_H */
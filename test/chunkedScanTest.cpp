@@ -0,0 +1,150 @@
+#include <string>
+#include <atomic>
+
+#include "xmlParser.hpp"
+#include "config.hpp"
+#include "check.hpp"
+
+//Parts of a document the chunk borders can fall into, every one of them forces the chunks to fall back to the serial scan
+//(or has to give the same result) when a border is placed inside it
+enum class feature
+{
+    nesting,
+    comments,
+    cdata,
+    attributes,
+};
+
+//Packages nested a few levels deep with elements, references and the given feature in every element.
+//padding moves every tag, so the chunk borders land in different places for every size
+std::string helper_makeDocument(feature documentFeature, size_t padding)
+{
+    std::string document = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<AUTOSAR>\n<AR-PACKAGES>\n";
+    for (int package = 0; package < 4; package++)
+    {
+        document += "<AR-PACKAGE><SHORT-NAME>Package" + std::to_string(package) + "</SHORT-NAME>\n<AR-PACKAGES>\n";
+        for (int subPackage = 0; subPackage < 3; subPackage++)
+        {
+            document += "  <AR-PACKAGE>\n    <SHORT-NAME>Sub" + std::to_string(subPackage) + "</SHORT-NAME>\n    <ELEMENTS>\n";
+            for (int element = 0; element < 4; element++)
+            {
+                const std::string name = "Element" + std::to_string(element);
+                document += "      <ELEMENT>\n        <SHORT-NAME>" + name + "</SHORT-NAME>\n";
+                document += "        <DESC>" + std::string(padding + element, ' ') + "text</DESC>\n";
+                switch (documentFeature)
+                {
+                case feature::nesting:
+                    //Shortnames that don't start a new level, and an element that stays open over the following ones
+                    document += "        <IDENT><SHORT-NAME>Ident" + name + "</SHORT-NAME></IDENT>\n";
+                    document += "        <SUB-ELEMENTS><SUB-ELEMENT><SHORT-NAME>Inner</SHORT-NAME>\n"
+                        "          <SUB-ELEMENTS><SUB-ELEMENT><SHORT-NAME>Innermost</SHORT-NAME></SUB-ELEMENT></SUB-ELEMENTS>\n"
+                        "        </SUB-ELEMENT></SUB-ELEMENTS>\n";
+                    break;
+                case feature::comments:
+                    document += "        <!-- <ELEMENT>\n          <SHORT-NAME>Commented</SHORT-NAME>\n"
+                        "          <TYPE-TREF DEST=\"TYPE\">/Commented</TYPE-TREF>\n        </ELEMENT> -->\n";
+                    break;
+                case feature::cdata:
+                    document += "        <DESC><![CDATA[<ELEMENT>\n          <SHORT-NAME>Quoted</SHORT-NAME>\n        </ELEMENT>]]></DESC>\n";
+                    break;
+                case feature::attributes:
+                    document += "        <ADMIN-DATA UUID=\"a>b\" T=\"<>\">\n          <SDG GID=\"x > y\">value</SDG>\n        </ADMIN-DATA>\n";
+                    break;
+                }
+                document += "        <TYPE-TREF DEST=\"TYPE\">/Package0/Sub0/Element" + std::to_string((element + 1) % 4) + "</TYPE-TREF>\n";
+                document += "      </ELEMENT>\n";
+            }
+            document += "    </ELEMENTS>\n  </AR-PACKAGE>\n";
+        }
+        document += "</AR-PACKAGES>\n</AR-PACKAGE>\n";
+    }
+    document += "</AR-PACKAGES>\n</AUTOSAR>\n";
+    return document;
+}
+
+bool helper_equal(const lsp::StagedFile &left, const lsp::StagedFile &right)
+{
+    if (left.newlineOffsets != right.newlineOffsets || left.shortnames.size() != right.shortnames.size() || left.references.size() != right.references.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < left.shortnames.size(); i++)
+    {
+        const lsp::StagedShortname &l = left.shortnames[i];
+        const lsp::StagedShortname &r = right.shortnames[i];
+        if (l.name != r.name || l.path != r.path || l.charOffset != r.charOffset || l.parent != r.parent)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < left.references.size(); i++)
+    {
+        const lsp::StagedReference &l = left.references[i];
+        const lsp::StagedReference &r = right.references[i];
+        if (l.name != r.name || l.targetPath != r.targetPath || l.charOffset != r.charOffset || l.owner != r.owner)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Scans the document serially and in 2 to 16 chunks and compares the results. Returns the number of chunked scans that fell back
+uint32_t testDocument(const std::string &document)
+{
+    const std::string uri = "file:///c%3A/chunked.arxml";
+    std::string log;
+    //Every document is scanned in chunks
+    lsp::config::IndexSettings settings;
+    settings.chunkedParsingMinFileSize = 0;
+    std::atomic<uint32_t> noThreads(0);
+    const lsp::StagedFile serial = lsp::XmlParser::scanContent(uri, document.data(), document.size(), 0, settings, noThreads, log);
+    CHECK(log.find("chunks") == std::string::npos);
+    //Tags in comments and CDATA sections are text
+    for (auto &shortname : serial.shortnames)
+    {
+        CHECK(shortname.name != "Commented" && shortname.name != "Quoted");
+    }
+
+    uint32_t fallbacks = 0;
+    for (uint32_t numThreads = 2; numThreads <= 16; numThreads++)
+    {
+        settings.indexingThreads = numThreads;
+        std::atomic<uint32_t> idleThreads(numThreads - 1);
+        const lsp::StagedFile chunked = lsp::XmlParser::scanContent(uri, document.data(), document.size(), 0, settings, idleThreads, log);
+        CHECK(helper_equal(serial, chunked));
+        //The borrowed threads are given back
+        CHECK(idleThreads == numThreads - 1);
+        if (log.find("parsing serially") != std::string::npos)
+        {
+            fallbacks++;
+        }
+        else
+        {
+            CHECK(log.find("chunks") != std::string::npos);
+        }
+    }
+    return fallbacks;
+}
+
+int main()
+{
+    for (feature documentFeature : {feature::nesting, feature::comments, feature::cdata, feature::attributes})
+    {
+        uint32_t fallbacks = 0;
+        for (size_t padding = 0; padding < 64; padding++)
+        {
+            fallbacks += testDocument(helper_makeDocument(documentFeature, padding));
+        }
+        //A border inside a comment or CDATA section can't be stitched, so some of the scans have to fall back
+        if (documentFeature == feature::comments || documentFeature == feature::cdata)
+        {
+            CHECK(fallbacks > 0);
+        }
+    }
+
+    //Smaller than the number of chunks and without any tag to split at
+    testDocument("<AUTOSAR/>");
+    testDocument("no tags at all");
+    return CHECK_RESULT();
+}
@@ -0,0 +1,101 @@
+#include <string>
+#include <fstream>
+#include <ctime>
+
+#include "boost/filesystem.hpp"
+
+#include "indexCache.hpp"
+#include "check.hpp"
+
+namespace fs = boost::filesystem;
+
+void helper_writeFile(const fs::path &path, const std::string &content)
+{
+    std::ofstream stream(path.string(), std::ios::binary | std::ios::trunc);
+    stream << content;
+}
+
+//A scanned file with nested shortnames, the paths are what the scanner produces
+lsp::StagedFile helper_makeFile(const std::string &uri, const std::string &content)
+{
+    lsp::StagedFile file;
+    file.uri = uri;
+    file.newlineOffsets = {0, 10, 20};
+    file.shortnames = {
+        {"Root", "", 5, -1},
+        {"Package", "Root", 15, 0},
+        {"Element", "Root/Package", 25, 1},
+        {"Sibling", "Root", 35, 0},
+        {"Other", "", 45, -1},
+    };
+    file.references = {{"Element", "/Root/Package/Element", 55, 3}};
+    file.contentHash = lsp::IndexCache::hashContent(content.data(), content.size());
+    return file;
+}
+
+void testRoundTrip(const fs::path &directory)
+{
+    const fs::path source = directory / "roundTrip.arxml";
+    const std::string content = "<AUTOSAR>round trip</AUTOSAR>";
+    helper_writeFile(source, content);
+    //Old enough that the entry is not racy
+    const std::time_t modificationTime = std::time(nullptr) - 60;
+    fs::last_write_time(source, modificationTime);
+
+    lsp::IndexCache cache((directory / "cache").string());
+    const lsp::StagedFile file = helper_makeFile("file://" + source.generic_string(), content);
+    cache.store(file, modificationTime, content.size());
+    //The temporary file was renamed to the cache file
+    for (auto &entry : fs::directory_iterator(directory / "cache"))
+    {
+        CHECK(entry.path().extension() == ".idx");
+    }
+
+    lsp::StagedFile loaded;
+    CHECK(cache.load(file.uri, source.string(), loaded));
+    CHECK(loaded.newlineOffsets == file.newlineOffsets);
+    CHECK(loaded.shortnames.size() == file.shortnames.size());
+    for (size_t i = 0; i < loaded.shortnames.size() && i < file.shortnames.size(); i++)
+    {
+        CHECK(loaded.shortnames[i].name == file.shortnames[i].name);
+        CHECK(loaded.shortnames[i].path == file.shortnames[i].path);
+        CHECK(loaded.shortnames[i].parent == file.shortnames[i].parent);
+        CHECK(loaded.shortnames[i].charOffset == file.shortnames[i].charOffset);
+    }
+    CHECK(loaded.references.size() == 1);
+    CHECK(loaded.references.size() == 1 && loaded.references[0].targetPath == "/Root/Package/Element");
+    CHECK(loaded.references.size() == 1 && loaded.references[0].owner == 3);
+}
+
+//A file rewritten with the same size right after it was scanned can keep its modification time, the content decides then
+void testRacyRewrite(const fs::path &directory)
+{
+    const fs::path source = directory / "racy.arxml";
+    const std::string content = "<AUTOSAR>version 1</AUTOSAR>";
+    helper_writeFile(source, content);
+    const std::time_t modificationTime = fs::last_write_time(source);
+
+    lsp::IndexCache cache((directory / "cache").string());
+    const lsp::StagedFile file = helper_makeFile("file://" + source.generic_string(), content);
+    cache.store(file, modificationTime, content.size());
+
+    helper_writeFile(source, "<AUTOSAR>version 2</AUTOSAR>");
+    fs::last_write_time(source, modificationTime);
+    lsp::StagedFile loaded;
+    CHECK(!cache.load(file.uri, source.string(), loaded));
+
+    //The same content is still loaded from the cache
+    helper_writeFile(source, content);
+    fs::last_write_time(source, modificationTime);
+    CHECK(cache.load(file.uri, source.string(), loaded));
+}
+
+int main()
+{
+    const fs::path directory = fs::temp_directory_path() / fs::unique_path("indexCacheTest-%%%%%%%%");
+    fs::create_directories(directory);
+    testRoundTrip(directory);
+    testRacyRewrite(directory);
+    fs::remove_all(directory);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,25 @@
+#include <string>
+
+#include "arxmlStorage.hpp"
+#include "check.hpp"
+
+using lsp::ArxmlStorage;
+
+int main()
+{
+    //Clients encode the drive letter and the separators differently
+    CHECK(ArxmlStorage::normalizeUri("file:///c%3A/Folder/a.arxml") == ArxmlStorage::normalizeUri("file:///C:/Folder/a.arxml"));
+    CHECK(ArxmlStorage::normalizeUri("file:///c:\\Folder\\a.arxml") == ArxmlStorage::normalizeUri("file:///c:/Folder/a.arxml"));
+    CHECK(ArxmlStorage::normalizeUri("FILE:///c:/a.arxml") == ArxmlStorage::normalizeUri("file:///c:/a.arxml"));
+    CHECK(ArxmlStorage::normalizeUri("file:///home/My%20Models/a.arxml") == "file:///home/My Models/a.arxml");
+#ifdef _WIN32
+    CHECK(ArxmlStorage::normalizeUri("file:///c:/Folder/A.arxml") == ArxmlStorage::normalizeUri("file:///c:/folder/a.arxml"));
+#else
+    //Files that only differ by case are different files
+    CHECK(ArxmlStorage::normalizeUri("file:///home/models/A.arxml") != ArxmlStorage::normalizeUri("file:///home/models/a.arxml"));
+    CHECK(ArxmlStorage::normalizeUri("file:///c:/Folder/a.arxml") != ArxmlStorage::normalizeUri("file:///c:/folder/a.arxml"));
+    //Only a drive letter is folded, not the start of any path
+    CHECK(ArxmlStorage::normalizeUri("file:///Home/a.arxml") == "file:///Home/a.arxml");
+#endif
+    return CHECK_RESULT();
+}
@@ -0,0 +1,93 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "messageParser.hpp"
+#include "requestExecutor.hpp"
+#include "check.hpp"
+
+std::string helper_request(int32_t id, const std::string &method, int32_t value)
+{
+    return json({{"jsonrpc", "2.0"}, {"id", id}, {"method", method}, {"params", {{"value", value}}}}).dump();
+}
+
+int main()
+{
+    std::mutex responsesMutex;
+    std::vector<json> responses;
+    //Set once both fast requests are answered, the slow request runs until then
+    std::atomic<bool> fastAnswered(false);
+
+    lsp::MessageParser parser;
+    auto executor = std::make_shared<lsp::RequestExecutor>(2);
+    parser.set_request_executor(executor, [&](jsonrpcpp::response_ptr response)
+    {
+        std::lock_guard<std::mutex> lock(responsesMutex);
+        responses.push_back(response->to_json());
+        if (responses.size() == 2)
+        {
+            fastAnswered = true;
+        }
+    });
+
+    //Stands in for a references request with thousands of results: it keeps a worker busy and checks its token while it runs
+    parser.register_concurrent_request_callback("test/slow", [&](const jsonrpcpp::Id &id, const json &params, const lsp::CancellationToken &token)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        while (!fastAnswered && std::chrono::steady_clock::now() - t0 < std::chrono::seconds(10))
+        {
+            token.throwIfCancelled();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return std::make_shared<jsonrpcpp::Response>(id, json(params["value"].get<int32_t>()));
+    });
+    //Stands in for a hover
+    parser.register_concurrent_request_callback("test/fast", [](const jsonrpcpp::Id &id, const json &params, [[maybe_unused]] const lsp::CancellationToken &token)
+    {
+        return std::make_shared<jsonrpcpp::Response>(id, json(params["value"].get<int32_t>()));
+    });
+
+    //The requests are submitted to the executor, parse() doesn't wait for them
+    CHECK(parser.parse(helper_request(1, "test/slow", 10)) == nullptr);
+    CHECK(parser.parse(helper_request(2, "test/fast", 20)) == nullptr);
+    CHECK(parser.parse(helper_request(3, "test/fast", 30)) == nullptr);
+    executor->waitUntilIdle();
+
+    //The fast requests are answered while the slow one still runs, so they come first. Every response has the id of its request
+    CHECK(fastAnswered);
+    CHECK(responses.size() == 3);
+    if (responses.size() == 3)
+    {
+        CHECK(responses[0]["id"] != 1 && responses[1]["id"] != 1);
+        CHECK(responses[2]["id"] == 1);
+        for (auto &response : responses)
+        {
+            CHECK(response["result"] == response["id"].get<int32_t>() * 10);
+        }
+    }
+
+    //A running request that is cancelled is answered with RequestCancelled under its own id
+    responses.clear();
+    fastAnswered = false;
+    CHECK(parser.parse(helper_request(4, "test/slow", 40)) == nullptr);
+    CHECK(parser.parse(helper_request(5, "test/fast", 50)) == nullptr);
+    parser.cancel_request(jsonrpcpp::Id(4));
+    executor->waitUntilIdle();
+    CHECK(responses.size() == 2);
+    for (auto &response : responses)
+    {
+        if (response["id"] == 4)
+        {
+            CHECK(response.contains("error") && response["error"]["code"] == -32800);
+        }
+        else
+        {
+            CHECK(response["id"] == 5 && response["result"] == 50);
+        }
+    }
+    return CHECK_RESULT();
+}